@@ -39,6 +39,8 @@ FIND_AND_ADD_CLANG_LIB(clangRewriteCore)
 FIND_AND_ADD_CLANG_LIB(clangRewriteFrontend)
 FIND_AND_ADD_CLANG_LIB(clangASTMatchers)
 FIND_AND_ADD_CLANG_LIB(clangToolingCore)
+# USRs of class summaries
+FIND_AND_ADD_CLANG_LIB(clangIndex)
 
 FIND_AND_ADD_CLANG_LIB(clang-cpp)
 
@@ -0,0 +1,11 @@
+int sum(int n) {
+    int i = 0, s = 0;
+    for (;;) {
+        if (i >= n)
+            break;
+        s = s + i;
+        i++;
+    }
+
+    return s;
+}
@@ -2,7 +2,10 @@
 
 #include <unordered_set>
 
+#include "clang/AST/RecursiveASTVisitor.h"
+
 #include "attribute.hpp"
+#include "metrics.hpp"
 
 namespace abreu {
 
@@ -10,10 +13,88 @@ namespace ast {
 
 using namespace clang;
 
-std::unordered_map<clang::CXXRecordDecl *, int> DerivedCount = {};
-std::unordered_map<clang::RecordDecl *, int> ReferenceCount = {};
+using RecordSet = std::unordered_set<const clang::CXXRecordDecl*>;
+
+// Identity of a class across its redeclarations; instantiations are
+// attributed to their pattern, the way classes are counted
+inline const clang::CXXRecordDecl* ClassKey(const clang::CXXRecordDecl* Record) {
+    if (const clang::CXXRecordDecl* Pattern = Record->getTemplateInstantiationPattern())
+        Record = Pattern;
+    return Record->getCanonicalDecl();
+}
+
+inline void AddSupplier(const clang::CXXRecordDecl* Record, RecordSet& Suppliers) {
+    if (Record)
+        Suppliers.insert(ClassKey(Record));
+}
+
+// Classes a type refers to: through pointers, references, arrays and type
+// template arguments (std::vector<Cat> uses Cat)
+inline void CollectSuppliers(clang::QualType Type, RecordSet& Suppliers) {
+    const clang::Type* T = Type.getTypePtrOrNull();
+    while (T) {
+        if (T->isAnyPointerType() || T->isReferenceType() || T->isMemberPointerType())
+            T = T->getPointeeType().getTypePtrOrNull();
+        else if (T->isArrayType())
+            T = T->getArrayElementTypeNoTypeQual();
+        else
+            break;
+    }
+    if (!T)
+        return;
+
+    const clang::CXXRecordDecl* Record = T->getAsCXXRecordDecl();
+    if (!Record)
+        return;
+
+    if (const auto* Spec = llvm::dyn_cast<clang::ClassTemplateSpecializationDecl>(Record))
+        for (const clang::TemplateArgument& Arg : Spec->getTemplateArgs().asArray())
+            if (Arg.getKind() == clang::TemplateArgument::Type)
+                CollectSuppliers(Arg.getAsType(), Suppliers);
+
+    AddSupplier(Record, Suppliers);
+}
+
+// Classes used inside a method body: locals, constructed and allocated
+// types, accessed members and called static methods
+struct BodySuppliers : clang::RecursiveASTVisitor<BodySuppliers> {
+    RecordSet& Suppliers;
+
+    explicit BodySuppliers(RecordSet& Suppliers) : Suppliers(Suppliers) {}
+
+    bool VisitVarDecl(clang::VarDecl* Var) {
+        CollectSuppliers(Var->getType(), Suppliers);
+        return true;
+    }
+
+    bool VisitCXXConstructExpr(clang::CXXConstructExpr* Construct) {
+        CollectSuppliers(Construct->getType(), Suppliers);
+        return true;
+    }
+
+    bool VisitCXXNewExpr(clang::CXXNewExpr* New) {
+        CollectSuppliers(New->getAllocatedType(), Suppliers);
+        return true;
+    }
+
+    bool VisitExplicitCastExpr(clang::ExplicitCastExpr* Cast) {
+        CollectSuppliers(Cast->getTypeAsWritten(), Suppliers);
+        return true;
+    }
+
+    bool VisitMemberExpr(clang::MemberExpr* Member) {
+        AddSupplier(llvm::dyn_cast<clang::CXXRecordDecl>(Member->getMemberDecl()->getDeclContext()), Suppliers);
+        return true;
+    }
 
-bool AreMethodSignaturesEqual(const CXXMethodDecl *Method1, const CXXMethodDecl *Method2) {
+    bool VisitDeclRefExpr(clang::DeclRefExpr* Ref) {
+        if (const auto* Method = llvm::dyn_cast<clang::CXXMethodDecl>(Ref->getDecl()))
+            AddSupplier(Method->getParent(), Suppliers);
+        return true;
+    }
+};
+
+inline bool AreMethodSignaturesEqual(const CXXMethodDecl *Method1, const CXXMethodDecl *Method2) {
     // Method names
     if (Method1->getNameAsString() != Method2->getNameAsString()) {
         return false;
@@ -41,7 +122,7 @@ bool AreMethodSignaturesEqual(const CXXMethodDecl *Method1, const CXXMethodDecl
     return true;
 }
 
-void FillAttributesAndMethods(clang::CXXRecordDecl* Record, std::vector<clang::CXXMethodDecl*>& Methods, std::vector<Attribute>& Attributes) {
+inline void FillAttributesAndMethods(clang::CXXRecordDecl* Record, std::vector<clang::CXXMethodDecl*>& Methods, std::vector<Attribute>& Attributes) {
     std::vector<std::string> Result;
     std::unordered_map<std::string, clang::CXXMethodDecl*> Getters;
 
@@ -49,7 +130,6 @@ void FillAttributesAndMethods(clang::CXXRecordDecl* Record, std::vector<clang::C
         std::string MethName = Meth->getNameAsString();
 
         if (MethName.find("get") == 0 && Meth->getNumParams() == 0) {
-            std::cout << "Found get: " << Meth->getNameAsString() << std::endl;
             std::string PropertyName = MethName.substr(3);
             Getters[PropertyName] = Meth;
         }
@@ -118,6 +198,9 @@ private:
     std::unordered_set<Attribute> NewVisibleAttributes = {};
     std::unordered_set<Attribute> NewHiddenAttributes = {};
 
+    RecordSet Suppliers = {};
+    std::vector<const clang::CXXRecordDecl*> DirectBases = {};
+
 public:
     int NewVisibleMethodsCnt() const { return NewVisibleMethods.size(); }
     int NewHiddenMethodsCnt() const { return NewHiddenMethods.size(); }
@@ -133,15 +216,27 @@ public:
     int InheritedOverrideAttributesCnt() const { return OverrideAttributes.size(); }
     int NewAttributesCnt() const { return NewAttributes.size(); }
 
-    int DerivedCnt() const { 
-        std::cout << Record_->getNameAsString() << std::endl;
-        std::cout << "Derived count: " << DerivedCount[Record_] << std::endl;
-        return DerivedCount[Record_]; 
-    }
-    int ReferenceCnt() const {
-        std::cout << Record_->getNameAsString() << std::endl;
-        std::cout << "Reference count: " << ReferenceCount[Record_] << std::endl;
-        return ReferenceCount[Record_];
+    int ReferenceCnt() const { return Suppliers.size(); }
+
+    const clang::CXXRecordDecl* Decl() const { return Record_; }
+    const RecordSet& SupplierDecls() const { return Suppliers; }
+    const std::vector<const clang::CXXRecordDecl*>& BaseDecls() const { return DirectBases; }
+
+    ClassRecord Counts() const {
+        ClassRecord Record;
+        Record.NewVisibleMethods = NewVisibleMethodsCnt();
+        Record.NewHiddenMethods = NewHiddenMethodsCnt();
+        Record.NewVisibleAttributes = NewVisibleAttributesCnt();
+        Record.NewHiddenAttributes = NewHiddenAttributesCnt();
+        Record.InheritedNotOverrideMethods = InheritedNotOverrideMethodsCnt();
+        Record.InheritedOverrideMethods = InheritedOverrideMethodsCnt();
+        Record.NewMethods = NewMethodsCnt();
+        Record.InheritedNotOverrideAttributes = InheritedNotOverrideAttributesCnt();
+        Record.InheritedOverrideAttributes = InheritedOverrideAttributesCnt();
+        Record.NewAttributes = NewAttributesCnt();
+        // Derived, Depth, Children and References need every class of the
+        // TU and are filled in by the Context
+        return Record;
     }
 
 private:
@@ -155,10 +250,6 @@ private:
             clang::CXXRecordDecl *BaseDecl = BaseType->getAsCXXRecordDecl();
 
             if (BaseDecl) {
-                std::cout << "  - " << BaseDecl->getNameAsString() << "\n";
-
-                DerivedCount[BaseDecl]++;
-
                 std::vector<clang::CXXMethodDecl*> BaseMethods = {};
                 std::vector<Attribute> BaseAttributes = {};
                 FillAttributesAndMethods(BaseDecl, BaseMethods, BaseAttributes);
@@ -182,43 +273,29 @@ private:
     }
 
 public:
-    Class(clang::CXXRecordDecl* Record, clang::ASTContext *Context) : Record_(Record) {
-        std::cout << "Name: " << Record->getNameAsString() << std::endl;
-
+    Class(clang::CXXRecordDecl* Record, clang::ASTContext *Context, bool Bodies) : Record_(Record) {
         traverseBaseClasses(Record);
 
-        std::cout << "Inherited Methods Count: " << InheritedMethods.size() << std::endl;
-        std::cout << "Inherited Attributes Count: " << InheritedAttributes.size() << std::endl;
-
-        // Found class refs
-        for (clang::FieldDecl* Field : Record->fields()) {
-            std::cout << "FIELD: " << Field->getNameAsString();
-            clang::QualType type = Field->getType();
-
-            // Structure pointee
-            if (type->isPointerType()) {
-                const clang::QualType pointeeType = type->getPointeeType();
-
-                if (const clang::RecordType *RefRecord = pointeeType->getAs<clang::RecordType>()) {
-                    std::cout << " IS POINTER TO RECORD" << std::endl;
-
-                    auto *ReferencedDecl = RefRecord->getDecl();
-                    if (ReferencedDecl->getNameAsString() != Record->getNameAsString()) {
-                        ReferenceCount[Record]++;
-                    }
-                }
-            } else if (const clang::RecordType *RefRecord = type->getAs<clang::RecordType>()) {
-                std::cout << " IS RECORD" << std::endl;
-
-                auto *ReferencedDecl = RefRecord->getDecl();
-                if (ReferencedDecl->getNameAsString() != Record->getNameAsString()) {
-                    ReferenceCount[Record]++;
-                }
-            }
-
-            std::cout << std::endl;
+        for (const auto &Base : Record->bases())
+            if (const clang::CXXRecordDecl* BaseDecl = Base.getType()->getAsCXXRecordDecl())
+                DirectBases.push_back(ClassKey(BaseDecl));
+
+        // Found class refs: fields, method signatures and, with Bodies,
+        // everything the methods use. Without it bodies are ignored even
+        // when present, so CF does not depend on how the AST was made
+        for (clang::FieldDecl* Field : Record->fields())
+            CollectSuppliers(Field->getType(), Suppliers);
+
+        for (clang::CXXMethodDecl* Meth : Record->methods()) {
+            CollectSuppliers(Meth->getReturnType(), Suppliers);
+            for (clang::ParmVarDecl* Param : Meth->parameters())
+                CollectSuppliers(Param->getType(), Suppliers);
+            if (clang::Stmt* Body = Bodies ? Meth->getBody() : nullptr)
+                BodySuppliers(Suppliers).TraverseStmt(Body);
         }
 
+        Suppliers.erase(ClassKey(Record));
+
         // Methods & Attrs
         FillAttributesAndMethods(Record, Methods, Attributes);
 
@@ -249,9 +326,6 @@ public:
                 NewAttributes.insert(Attr);
         }
 
-        std::cout << "Override Methods Count: " << OverrideMethods.size() << std::endl;
-        std::cout << "Override Attributes Count: " << OverrideAttributes.size() << std::endl;
-
         for (clang::CXXMethodDecl* Meth : NewMethods) {
             if (Meth->getAccess() == clang::AccessSpecifier::AS_public)
                 NewVisibleMethods.insert(Meth);
@@ -259,20 +333,12 @@ public:
                 NewHiddenMethods.insert(Meth);
         }
 
-        std::cout << "New Visible Methods Count: " << NewVisibleMethods.size() << std::endl;
-        std::cout << "New Hidden Methods Count: " << NewHiddenMethods.size() << std::endl;
-
         for (Attribute Attr : NewAttributes) {
             if (Attr.Access == clang::AccessSpecifier::AS_public)
                 NewVisibleAttributes.insert(Attr);
             if (Attr.Access == clang::AccessSpecifier::AS_protected || Attr.Access == clang::AccessSpecifier::AS_private)
                 NewHiddenAttributes.insert(Attr);
         }
-
-        std::cout << "New Visible Attributes Count: " << NewVisibleAttributes.size() << std::endl;
-        std::cout << "New Hidden Attributes Count: " << NewHiddenAttributes.size() << std::endl;
-
-        std::cout << std::endl;
     }
 };
 
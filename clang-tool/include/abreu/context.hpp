@@ -1,105 +1,151 @@
 #pragma once
 
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+
+#include "clang/Index/USRGeneration.h"
+#include "llvm/ADT/SmallString.h"
+
 #include "ast.hpp"
+#include "coupling.hpp"
+#include "hierarchy.hpp"
+#include "metrics.hpp"
+#include "summary.hpp"
 
 namespace abreu {
 
 struct Context {
 private:
+    std::vector<std::unique_ptr<ast::Class>> Owned;
     std::vector<ast::Class*> Classes;
+    // The record each class was pushed for, the specialization of an
+    // instantiation; parallel to Classes
+    std::vector<const clang::CXXRecordDecl*> Pushed;
 
-private:
-    double MethodHidingFactor() const {
-        double hidden = 0;
-        double all = 0;
-        for (auto* Class : Classes) {
-            hidden += Class->NewHiddenMethodsCnt();
-
-            all += Class->NewVisibleMethodsCnt();
-            all += Class->NewHiddenMethodsCnt();
-        }
-        return hidden / all;
+public:
+    // Analyses the record; the class is owned by the context but is only
+    // counted once pushed (instantiations push their pattern's class)
+    ast::Class* Make(clang::CXXRecordDecl* Record, clang::ASTContext* Context, bool Bodies) {
+        Owned.push_back(std::make_unique<ast::Class>(Record, Context, Bodies));
+        return Owned.back().get();
     }
 
-    double AttributeHidingFactor() const {
-        double hidden = 0;
-        double all = 0;
-        for (auto* Class : Classes) {
-            hidden += Class->NewHiddenAttributesCnt();
-
-            all += Class->NewVisibleAttributesCnt();
-            all += Class->NewHiddenAttributesCnt();
-        }
-        return hidden / all;
+    void Push(ast::Class* NewClass, const clang::CXXRecordDecl* Record = nullptr) {
+        Classes.push_back(NewClass);
+        Pushed.push_back(Record ? Record : NewClass->Decl());
     }
 
-    double MethodInheritanceFactor() const {
-        double NotOverriden = 0;
-        double All = 0;
-        for (auto* Class : Classes) {
-            NotOverriden += Class->InheritedNotOverrideMethodsCnt();
-
-            All += Class->InheritedNotOverrideMethodsCnt();
-            All += Class->InheritedOverrideMethodsCnt();
-            All += Class->NewMethodsCnt();
+public:
+    // Derived counts are only final once the whole TU was visited, so the
+    // records are taken here rather than on Push
+    std::vector<ClassRecord> Records() const {
+        std::vector<ClassRecord> Result;
+        Result.reserve(Classes.size());
+        for (auto* Class : Classes)
+            Result.push_back(Class->Counts());
+
+        CouplingMatrix Coupling = Couplings();
+        HierarchyIndex Hierarchy = Inheritance();
+        for (size_t Index = 0; Index < Result.size(); ++Index) {
+            Result[Index].References = Coupling.RowCount(Index);
+            Result[Index].Derived = Hierarchy.Descendants(Index);
+            Result[Index].Depth = Hierarchy.Depth(Index);
+            Result[Index].Children = Hierarchy.Children(Index);
         }
-        return NotOverriden / All;
+
+        return Result;
     }
 
-    double AttributeInheritanceFactor() const {
-        double NotOverriden = 0;
-        double All = 0;
-        for (auto* Class : Classes) {
-            NotOverriden += Class->InheritedNotOverrideAttributesCnt();
+    std::unordered_map<const clang::CXXRecordDecl*, uint32_t> Indices() const {
+        std::unordered_map<const clang::CXXRecordDecl*, uint32_t> Result;
+        for (size_t Index = 0; Index < Classes.size(); ++Index)
+            Result.emplace(ast::ClassKey(Classes[Index]->Decl()), Index);
+        return Result;
+    }
 
-            All += Class->InheritedNotOverrideAttributesCnt();
-            All += Class->InheritedOverrideAttributesCnt();
-            All += Class->NewAttributesCnt();
+    // Suppliers outside of the analysed classes (filtered headers,
+    // incomplete types) do not take part in the Coupling Factor
+    CouplingMatrix Couplings() const {
+        auto Indices = this->Indices();
+
+        std::vector<std::pair<uint32_t, uint32_t>> Pairs;
+        for (size_t Index = 0; Index < Classes.size(); ++Index) {
+            for (const auto* Supplier : Classes[Index]->SupplierDecls()) {
+                auto Found = Indices.find(Supplier);
+                if (Found != Indices.end())
+                    Pairs.emplace_back(Index, Found->second);
+            }
         }
-        return NotOverriden / All;
-    }
 
-    double PolymorphismFactor() const {
-        double Overriden = 0;
-        double All = 0;
-        for (auto* Class : Classes) {
-            Overriden += Class->InheritedOverrideMethodsCnt();
-            // std::cout << Class->InheritedOverrideMethodsCnt() << " " << Class->NewMethodsCnt() << " " << Class->DerivedCnt() << std::endl;
+        return CouplingMatrix(Classes.size(), std::move(Pairs));
+    }
 
-            All += Class->NewMethodsCnt() * Class->DerivedCnt();
+    // Bases outside of the analysed classes are not indexed, so they count
+    // neither as descendants' ancestors nor towards the depth
+    HierarchyIndex Inheritance() const {
+        auto Indices = this->Indices();
+
+        std::vector<std::pair<uint32_t, uint32_t>> Edges;
+        for (size_t Index = 0; Index < Classes.size(); ++Index) {
+            for (const auto* Base : Classes[Index]->BaseDecls()) {
+                auto Found = Indices.find(Base);
+                if (Found != Indices.end())
+                    Edges.emplace_back(Index, Found->second);
+            }
         }
-        return Overriden / All;
-    }
 
-    double CouplingFactor() const {
-        double N = Classes.size();
-        double Cij = 0;
+        return HierarchyIndex(Classes.size(), std::move(Edges));
+    }
 
-        for (auto* Class : Classes) {
-            if (int RefCnt = Class->ReferenceCnt()) {
-                Cij += RefCnt;
-            }
+    // Plain data of every class, keyed by USR so that classes of different
+    // TUs can be matched once the ASTs are gone
+    std::vector<ClassSummary> Summaries() const {
+        auto Usr = [](const clang::CXXRecordDecl* Record) {
+            llvm::SmallString<128> Buffer;
+            if (clang::index::generateUSRForDecl(Record, Buffer))
+                return Record->getQualifiedNameAsString();
+            return std::string(Buffer);
+        };
+
+        std::vector<ClassSummary> Result;
+        Result.reserve(Classes.size());
+        for (size_t Index = 0; Index < Classes.size(); ++Index) {
+            const ast::Class* Class = Classes[Index];
+            ClassSummary Summary;
+            // Every instantiation of a pattern shares the Class, its own
+            // USR keeps them apart once merged
+            Summary.Usr = Usr(Pushed[Index]->getCanonicalDecl());
+            if (Pushed[Index] != Class->Decl())
+                Summary.Pattern = Usr(ast::ClassKey(Class->Decl()));
+            Summary.Name = Class->Decl()->getQualifiedNameAsString();
+            Summary.Counts = Class->Counts();
+            for (const auto* Base : Class->BaseDecls())
+                Summary.Bases.push_back(Usr(Base));
+            for (const auto* Supplier : Class->SupplierDecls())
+                Summary.Suppliers.push_back(Usr(Supplier));
+            // Set order follows addresses, sorted the summary is the same
+            // on every run
+            std::sort(Summary.Suppliers.begin(), Summary.Suppliers.end());
+            Result.push_back(std::move(Summary));
         }
+        return Result;
+    }
 
-        if (N == 0) 
-            return 0;
-        return Cij / (N * (N - 1));
+    Factors Compute() const {
+        return Reduce(Records()).Finish();
     }
 
-public:
-    void Push(ast::Class* NewClass) {
-        Classes.push_back(NewClass);
+    // Takes all records at once, see Outliers
+    void Report(Outliers &Report) const {
+        std::vector<ClassRecord> Records = this->Records();
+        for (size_t Index = 0; Index < Records.size(); ++Index)
+            Report.Add(Records[Index], Classes[Index]->Decl()->getQualifiedNameAsString());
     }
 
-public:
-    void Stats() const {
-        std::cout << "Method Hiding Factor: " << MethodHidingFactor() << std::endl;
-        std::cout << "Attribute Hiding Factor: " << AttributeHidingFactor() << std::endl;
-        std::cout << "Method Inheritance Factor: " << MethodInheritanceFactor() << std::endl;
-        std::cout << "Attribute Inheritance Factor: " << AttributeInheritanceFactor() << std::endl;
-        std::cout << "Polymorphism Factor: " << PolymorphismFactor() << std::endl;
-        std::cout << "Coupling Factor: " << CouplingFactor() << std::endl;
+    void Stats(std::ostream &out) const {
+        Print(Compute(), out);
     }
 };
 
-}
\ No newline at end of file
+}
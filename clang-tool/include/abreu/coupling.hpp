@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace abreu {
+
+// Client -> supplier relation between class indices, stored as a compressed
+// sparse bitset: every row keeps only its non-zero 64-bit words, in order.
+struct CouplingMatrix {
+private:
+    std::vector<size_t> RowStart;
+    std::vector<uint32_t> WordIndex;
+    std::vector<uint64_t> Words;
+
+public:
+    CouplingMatrix(size_t Classes, std::vector<std::pair<uint32_t, uint32_t>> Pairs) {
+        std::sort(Pairs.begin(), Pairs.end());
+
+        RowStart.assign(Classes + 1, 0);
+        for (const auto& [Client, Supplier] : Pairs) {
+            // A class never couples with itself
+            if (Client == Supplier)
+                continue;
+
+            uint32_t Word = Supplier / 64;
+            bool SameWord = !WordIndex.empty() && RowStart[Client + 1] != 0 && WordIndex.back() == Word;
+            if (!SameWord) {
+                WordIndex.push_back(Word);
+                Words.push_back(0);
+                RowStart[Client + 1]++;
+            }
+            Words.back() |= uint64_t(1) << (Supplier % 64);
+        }
+
+        for (size_t Row = 0; Row < Classes; ++Row)
+            RowStart[Row + 1] += RowStart[Row];
+    }
+
+public:
+    size_t Classes() const { return RowStart.size() - 1; }
+
+    bool Test(uint32_t Client, uint32_t Supplier) const {
+        auto Begin = WordIndex.begin() + RowStart[Client];
+        auto End = WordIndex.begin() + RowStart[Client + 1];
+        auto Word = std::lower_bound(Begin, End, Supplier / 64);
+        if (Word == End || *Word != Supplier / 64)
+            return false;
+        return Words[Word - WordIndex.begin()] >> (Supplier % 64) & 1;
+    }
+
+    // Distinct suppliers of one client
+    size_t RowCount(uint32_t Client) const {
+        size_t Count = 0;
+        for (size_t Word = RowStart[Client]; Word < RowStart[Client + 1]; ++Word)
+            Count += __builtin_popcountll(Words[Word]);
+        return Count;
+    }
+
+    // Distinct client-supplier pairs
+    size_t Count() const {
+        size_t Count = 0;
+        for (uint64_t Word : Words)
+            Count += __builtin_popcountll(Word);
+        return Count;
+    }
+};
+
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace abreu {
+
+// Inheritance between class indices: direct bases in CSR form and the
+// transitive closure as one sparse bitset of ancestors per class, built
+// once in topological order (every base before its derived classes).
+struct HierarchyIndex {
+private:
+    // Non-zero 64-bit words of a bitset, ordered by word index
+    using SparseBits = std::vector<std::pair<uint32_t, uint64_t>>;
+
+private:
+    std::vector<uint32_t> BaseStart;
+    std::vector<uint32_t> Bases;
+    std::vector<uint32_t> ChildCount;
+
+    std::vector<SparseBits> Ancestors;
+    std::vector<uint32_t> DescendantCount;
+    std::vector<uint32_t> DepthOf;
+
+private:
+    static void Set(SparseBits& Bits, uint32_t Bit) {
+        uint32_t Word = Bit / 64;
+        auto Pos = std::lower_bound(Bits.begin(), Bits.end(), std::make_pair(Word, uint64_t(0)));
+        if (Pos == Bits.end() || Pos->first != Word)
+            Pos = Bits.insert(Pos, {Word, 0});
+        Pos->second |= uint64_t(1) << (Bit % 64);
+    }
+
+    static SparseBits Union(const SparseBits& Lhs, const SparseBits& Rhs) {
+        SparseBits Result;
+        Result.reserve(Lhs.size() + Rhs.size());
+        size_t L = 0, R = 0;
+        while (L < Lhs.size() || R < Rhs.size()) {
+            if (R == Rhs.size() || (L < Lhs.size() && Lhs[L].first < Rhs[R].first))
+                Result.push_back(Lhs[L++]);
+            else if (L == Lhs.size() || Rhs[R].first < Lhs[L].first)
+                Result.push_back(Rhs[R++]);
+            else {
+                Result.push_back({Lhs[L].first, Lhs[L].second | Rhs[R].second});
+                ++L;
+                ++R;
+            }
+        }
+        return Result;
+    }
+
+    // Kahn's algorithm over base -> derived edges. Valid C++ has no cycles;
+    // should merged input contain one, its classes are appended unordered.
+    std::vector<uint32_t> TopologicalOrder() const {
+        size_t N = Classes();
+
+        std::vector<uint32_t> Pending(N);
+        std::vector<std::vector<uint32_t>> Derived(N);
+        for (uint32_t Class = 0; Class < N; ++Class) {
+            Pending[Class] = BaseStart[Class + 1] - BaseStart[Class];
+            for (uint32_t Edge = BaseStart[Class]; Edge < BaseStart[Class + 1]; ++Edge)
+                Derived[Bases[Edge]].push_back(Class);
+        }
+
+        std::vector<uint32_t> Order;
+        Order.reserve(N);
+        for (uint32_t Class = 0; Class < N; ++Class)
+            if (!Pending[Class])
+                Order.push_back(Class);
+
+        for (size_t Head = 0; Head < Order.size(); ++Head)
+            for (uint32_t Child : Derived[Order[Head]])
+                if (--Pending[Child] == 0)
+                    Order.push_back(Child);
+
+        for (uint32_t Class = 0; Class < N; ++Class)
+            if (Pending[Class])
+                Order.push_back(Class);
+
+        return Order;
+    }
+
+public:
+    // Edges are (derived, base) pairs of class indices
+    HierarchyIndex(size_t N, std::vector<std::pair<uint32_t, uint32_t>> Edges) {
+        std::sort(Edges.begin(), Edges.end());
+        Edges.erase(std::unique(Edges.begin(), Edges.end()), Edges.end());
+
+        BaseStart.assign(N + 1, 0);
+        ChildCount.assign(N, 0);
+        for (const auto& [Derived, Base] : Edges) {
+            if (Derived == Base)
+                continue;
+            BaseStart[Derived + 1]++;
+            Bases.push_back(Base);
+            ChildCount[Base]++;
+        }
+        for (size_t Class = 0; Class < N; ++Class)
+            BaseStart[Class + 1] += BaseStart[Class];
+
+        Ancestors.assign(N, {});
+        DepthOf.assign(N, 0);
+        for (uint32_t Class : TopologicalOrder()) {
+            for (uint32_t Edge = BaseStart[Class]; Edge < BaseStart[Class + 1]; ++Edge) {
+                uint32_t Base = Bases[Edge];
+                Ancestors[Class] = Union(Ancestors[Class], Ancestors[Base]);
+                Set(Ancestors[Class], Base);
+                DepthOf[Class] = std::max(DepthOf[Class], DepthOf[Base] + 1);
+            }
+        }
+
+        DescendantCount.assign(N, 0);
+        for (const SparseBits& Bits : Ancestors)
+            for (const auto& [Word, Mask] : Bits)
+                for (uint64_t Rest = Mask; Rest; Rest &= Rest - 1)
+                    DescendantCount[Word * 64 + __builtin_ctzll(Rest)]++;
+    }
+
+public:
+    size_t Classes() const { return BaseStart.size() - 1; }
+
+    std::vector<uint32_t> DirectBases(uint32_t Class) const {
+        return {Bases.begin() + BaseStart[Class], Bases.begin() + BaseStart[Class + 1]};
+    }
+
+    bool IsAncestor(uint32_t Ancestor, uint32_t Class) const {
+        const SparseBits& Bits = Ancestors[Class];
+        auto Pos = std::lower_bound(Bits.begin(), Bits.end(), std::make_pair(Ancestor / 64, uint64_t(0)));
+        return Pos != Bits.end() && Pos->first == Ancestor / 64 && (Pos->second >> (Ancestor % 64) & 1);
+    }
+
+    // All classes that inherit from Class, directly or not
+    int Descendants(uint32_t Class) const { return DescendantCount[Class]; }
+
+    // Number of Children (NOC)
+    int Children(uint32_t Class) const { return ChildCount[Class]; }
+
+    // Depth of Inheritance Tree (DIT), a root class has depth 0
+    int Depth(uint32_t Class) const { return DepthOf[Class]; }
+};
+
+}
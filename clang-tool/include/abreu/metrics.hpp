@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace abreu {
+
+// Everything the six factors need from one class, so that the reduction
+// walks a contiguous array instead of chasing Class pointers
+struct ClassRecord {
+    int NewVisibleMethods = 0;
+    int NewHiddenMethods = 0;
+    int NewVisibleAttributes = 0;
+    int NewHiddenAttributes = 0;
+
+    int InheritedNotOverrideMethods = 0;
+    int InheritedOverrideMethods = 0;
+    int NewMethods = 0;
+
+    int InheritedNotOverrideAttributes = 0;
+    int InheritedOverrideAttributes = 0;
+    int NewAttributes = 0;
+
+    int Derived = 0;
+    int References = 0;
+
+    // Depth of Inheritance Tree and Number of Children
+    int Depth = 0;
+    int Children = 0;
+};
+
+struct Factors {
+    double MethodHiding = 0;
+    double AttributeHiding = 0;
+    double MethodInheritance = 0;
+    double AttributeInheritance = 0;
+    double Polymorphism = 0;
+    double Coupling = 0;
+
+    // Not MOOD factors, reported alongside them
+    double AverageDepth = 0;
+    int MaxDepth = 0;
+    double AverageChildren = 0;
+    int MaxChildren = 0;
+};
+
+// Confidence interval of an estimated factor
+struct Interval {
+    double Low = 0;
+    double High = 0;
+};
+
+// MHF, AHF, MIF, AIF, PF, CF in this order
+using FactorIntervals = std::array<Interval, 6>;
+
+// The six factors, then DIT and NOC; with Intervals every factor is
+// followed by its confidence interval
+inline void Print(const Factors& Result, std::ostream& out, const FactorIntervals* Intervals = nullptr) {
+    auto Line = [&](const char* Name, double Value, size_t Index) {
+        out << Name << ": " << Value;
+        if (Intervals)
+            out << " [" << (*Intervals)[Index].Low << ", " << (*Intervals)[Index].High << "]";
+        out << '\n';
+    };
+    Line("Method Hiding Factor", Result.MethodHiding, 0);
+    Line("Attribute Hiding Factor", Result.AttributeHiding, 1);
+    Line("Method Inheritance Factor", Result.MethodInheritance, 2);
+    Line("Attribute Inheritance Factor", Result.AttributeInheritance, 3);
+    Line("Polymorphism Factor", Result.Polymorphism, 4);
+    Line("Coupling Factor", Result.Coupling, 5);
+    out << "Depth of Inheritance Tree (avg/max): " << Result.AverageDepth << " / " << Result.MaxDepth << '\n';
+    out << "Number of Children (avg/max): " << Result.AverageChildren << " / " << Result.MaxChildren << '\n';
+}
+
+// Numerators and denominators of all factors. Integer sums are exact, so
+// the result does not depend on how the records were split between threads.
+struct Sums {
+    long long HiddenMethods = 0;
+    long long AllMethods = 0;
+    long long HiddenAttributes = 0;
+    long long AllAttributes = 0;
+    long long NotOverridenMethods = 0;
+    long long AvailableMethods = 0;
+    long long NotOverridenAttributes = 0;
+    long long AvailableAttributes = 0;
+    long long Overriden = 0;
+    long long PolymorphicSituations = 0;
+    long long Couplings = 0;
+    long long Classes = 0;
+    long long Depth = 0;
+    long long Children = 0;
+    int MaxDepth = 0;
+    int MaxChildren = 0;
+
+public:
+    void Add(const ClassRecord& Record) {
+        HiddenMethods += Record.NewHiddenMethods;
+        AllMethods += Record.NewVisibleMethods + Record.NewHiddenMethods;
+
+        HiddenAttributes += Record.NewHiddenAttributes;
+        AllAttributes += Record.NewVisibleAttributes + Record.NewHiddenAttributes;
+
+        NotOverridenMethods += Record.InheritedNotOverrideMethods;
+        AvailableMethods += Record.InheritedNotOverrideMethods + Record.InheritedOverrideMethods + Record.NewMethods;
+
+        NotOverridenAttributes += Record.InheritedNotOverrideAttributes;
+        AvailableAttributes += Record.InheritedNotOverrideAttributes + Record.InheritedOverrideAttributes + Record.NewAttributes;
+
+        Overriden += Record.InheritedOverrideMethods;
+        PolymorphicSituations += static_cast<long long>(Record.NewMethods) * Record.Derived;
+
+        Couplings += Record.References;
+        Classes += 1;
+
+        Depth += Record.Depth;
+        Children += Record.Children;
+        MaxDepth = std::max(MaxDepth, Record.Depth);
+        MaxChildren = std::max(MaxChildren, Record.Children);
+    }
+
+    void Merge(const Sums& Other) {
+        HiddenMethods += Other.HiddenMethods;
+        AllMethods += Other.AllMethods;
+        HiddenAttributes += Other.HiddenAttributes;
+        AllAttributes += Other.AllAttributes;
+        NotOverridenMethods += Other.NotOverridenMethods;
+        AvailableMethods += Other.AvailableMethods;
+        NotOverridenAttributes += Other.NotOverridenAttributes;
+        AvailableAttributes += Other.AvailableAttributes;
+        Overriden += Other.Overriden;
+        PolymorphicSituations += Other.PolymorphicSituations;
+        Couplings += Other.Couplings;
+        Classes += Other.Classes;
+        Depth += Other.Depth;
+        Children += Other.Children;
+        MaxDepth = std::max(MaxDepth, Other.MaxDepth);
+        MaxChildren = std::max(MaxChildren, Other.MaxChildren);
+    }
+
+    // Factors with nothing to count (no classes, methods or attributes) are 0
+    Factors Finish() const {
+        auto Ratio = [](double Part, double Whole) { return Whole == 0 ? 0 : Part / Whole; };
+
+        Factors Result;
+        Result.MethodHiding = Ratio(HiddenMethods, AllMethods);
+        Result.AttributeHiding = Ratio(HiddenAttributes, AllAttributes);
+        Result.MethodInheritance = Ratio(NotOverridenMethods, AvailableMethods);
+        Result.AttributeInheritance = Ratio(NotOverridenAttributes, AvailableAttributes);
+        Result.Polymorphism = Ratio(Overriden, PolymorphicSituations);
+
+        double N = Classes;
+        Result.Coupling = Ratio(Couplings, N * (N - 1));
+
+        Result.AverageDepth = Ratio(Depth, N);
+        Result.MaxDepth = MaxDepth;
+        Result.AverageChildren = Ratio(Children, N);
+        Result.MaxChildren = MaxChildren;
+        return Result;
+    }
+};
+
+// Below this many records per thread spawning costs more than it saves
+constexpr size_t MinRecordsPerThread = 1 << 14;
+
+// One fused pass over all records, split into equal chunks; partial sums
+// are combined pairwise in a fixed tree order
+inline Sums Reduce(const std::vector<ClassRecord>& Records) {
+    size_t Threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    Threads = std::min(Threads, std::max<size_t>(1, Records.size() / MinRecordsPerThread));
+
+    size_t Chunk = (Records.size() + Threads - 1) / Threads;
+    std::vector<Sums> Partial(Threads);
+
+    auto ReduceChunk = [&](size_t Index) {
+        size_t Begin = std::min(Records.size(), Index * Chunk);
+        size_t End = std::min(Records.size(), Begin + Chunk);
+        for (size_t I = Begin; I < End; ++I)
+            Partial[Index].Add(Records[I]);
+    };
+
+    std::vector<std::thread> Workers;
+    for (size_t Index = 1; Index < Threads; ++Index)
+        Workers.emplace_back(ReduceChunk, Index);
+    ReduceChunk(0);
+    for (auto& Worker : Workers)
+        Worker.join();
+
+    for (size_t Stride = 1; Stride < Threads; Stride *= 2)
+        for (size_t Index = 0; Index + Stride < Threads; Index += 2 * Stride)
+            Partial[Index].Merge(Partial[Index + Stride]);
+
+    return Partial.front();
+}
+
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "metrics.hpp"
+
+namespace abreu {
+
+// The K classes with the largest value seen so far, kept in a min-heap of
+// K entries; equal values are ranked by name so the result is stable
+struct TopK {
+private:
+    using Entry = std::pair<long long, std::string>;
+
+    // Heap order: the entry to evict first on top
+    static bool Evict(const Entry& Left, const Entry& Right) {
+        if (Left.first != Right.first)
+            return Left.first > Right.first;
+        return Left.second < Right.second;
+    }
+
+private:
+    size_t K;
+    std::vector<Entry> Heap;
+
+public:
+    explicit TopK(size_t K) : K(K) {}
+
+public:
+    void Add(long long Value, const std::string& Name) {
+        if (!K || Value <= 0)
+            return;
+        if (Heap.size() == K) {
+            if (!Evict({Value, Name}, Heap.front()))
+                return;
+            std::pop_heap(Heap.begin(), Heap.end(), Evict);
+            Heap.back() = {Value, Name};
+        } else {
+            Heap.push_back({Value, Name});
+        }
+        std::push_heap(Heap.begin(), Heap.end(), Evict);
+    }
+
+    // Largest first
+    std::vector<Entry> Sorted() const {
+        std::vector<Entry> Result = Heap;
+        std::sort(Result.begin(), Result.end(), Evict);
+        return Result;
+    }
+};
+
+// Counts in power-of-two buckets: 0, 1, 2-3, 4-7, ... and a last bucket
+// for everything larger
+struct Histogram {
+public:
+    static constexpr size_t Buckets = 24;
+
+public:
+    std::array<uint64_t, Buckets> Counts = {};
+
+public:
+    static size_t Bucket(long long Value) {
+        if (Value <= 0)
+            return 0;
+        size_t Bits = 64 - __builtin_clzll(static_cast<unsigned long long>(Value));
+        return std::min(Bits, Buckets - 1);
+    }
+
+    void Add(long long Value) { Counts[Bucket(Value)]++; }
+
+    void Print(std::ostream& out) const {
+        size_t Last = Buckets;
+        while (Last > 0 && !Counts[Last - 1])
+            --Last;
+        for (size_t Index = 0; Index < Last; ++Index) {
+            long long Low = Index ? 1ll << (Index - 1) : 0;
+            long long High = Index ? (1ll << Index) - 1 : 0;
+            out << "  " << Low;
+            if (Index == Buckets - 1)
+                out << "+";
+            else if (High != Low)
+                out << "-" << High;
+            out << ": " << Counts[Index] << '\n';
+        }
+    }
+};
+
+// Classes driving the factors, fed one record at a time: the top
+// contributors of MHF, MIF, CF and PF, and the spread of every count.
+// The report itself keeps O(K) entries, but its records are not streamed:
+// References and Derived need the whole coupling and inheritance graphs,
+// so the callers (Context::Report, Project::Report) build every record
+// first.
+struct Outliers {
+public:
+    TopK HiddenMethods;
+    TopK InheritedMethods;
+    TopK References;
+    TopK Polymorphism;
+
+    // One per ClassRecord field, in declaration order
+    std::array<Histogram, 14> Histograms;
+
+public:
+    explicit Outliers(size_t K) : HiddenMethods(K), InheritedMethods(K), References(K), Polymorphism(K) {}
+
+public:
+    void Add(const ClassRecord& Record, const std::string& Name) {
+        HiddenMethods.Add(Record.NewHiddenMethods, Name);
+        InheritedMethods.Add(Record.InheritedNotOverrideMethods, Name);
+        References.Add(Record.References, Name);
+        Polymorphism.Add(static_cast<long long>(Record.NewMethods) * Record.Derived, Name);
+
+        const int Fields[] = {Record.NewVisibleMethods,
+                              Record.NewHiddenMethods,
+                              Record.NewVisibleAttributes,
+                              Record.NewHiddenAttributes,
+                              Record.InheritedNotOverrideMethods,
+                              Record.InheritedOverrideMethods,
+                              Record.NewMethods,
+                              Record.InheritedNotOverrideAttributes,
+                              Record.InheritedOverrideAttributes,
+                              Record.NewAttributes,
+                              Record.Derived,
+                              Record.References,
+                              Record.Depth,
+                              Record.Children};
+        for (size_t Field = 0; Field < Histograms.size(); ++Field)
+            Histograms[Field].Add(Fields[Field]);
+    }
+
+    void Print(std::ostream& out) const {
+        auto Top = [&out](const char* Title, const TopK& Top) {
+            out << Title << ":\n";
+            for (const auto& [Value, Name] : Top.Sorted())
+                out << "  " << Value << '\t' << Name << '\n';
+        };
+        Top("Hidden methods", HiddenMethods);
+        Top("Inherited, not overridden methods", InheritedMethods);
+        Top("References", References);
+        Top("New methods x descendants", Polymorphism);
+
+        const char* Names[] = {"New visible methods",
+                               "New hidden methods",
+                               "New visible attributes",
+                               "New hidden attributes",
+                               "Inherited, not overridden methods",
+                               "Overridden methods",
+                               "New methods",
+                               "Inherited, not overridden attributes",
+                               "Overridden attributes",
+                               "New attributes",
+                               "Descendants",
+                               "References",
+                               "Depth of Inheritance Tree",
+                               "Number of Children"};
+        for (size_t Field = 0; Field < Histograms.size(); ++Field) {
+            out << Names[Field] << " (histogram):\n";
+            Histograms[Field].Print(out);
+        }
+    }
+};
+
+}
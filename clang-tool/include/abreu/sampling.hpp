@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "metrics.hpp"
+
+namespace abreu {
+
+// SplitMix64: fixed output for a seed on every platform, unlike the
+// distributions of <random>
+struct Random {
+private:
+    uint64_t State;
+
+public:
+    explicit Random(uint64_t Seed) : State(Seed) {}
+
+public:
+    uint64_t Next() {
+        uint64_t Value = (State += 0x9e3779b97f4a7c15ull);
+        Value = (Value ^ (Value >> 30)) * 0xbf58476d1ce4e5b9ull;
+        Value = (Value ^ (Value >> 27)) * 0x94d049bb133111ebull;
+        return Value ^ (Value >> 31);
+    }
+
+    // Uniform in [0, Bound)
+    size_t Below(size_t Bound) { return static_cast<size_t>((static_cast<unsigned __int128>(Next()) * Bound) >> 64); }
+
+    // Uniform in [0, 1)
+    double Unit() { return (Next() >> 11) * 0x1.0p-53; }
+};
+
+inline uint64_t HashPath(const std::string& Path) {
+    uint64_t Hash = 0xcbf29ce484222325ull;
+    for (unsigned char Char : Path) {
+        Hash ^= Char;
+        Hash *= 0x100000001b3ull;
+    }
+    return Hash;
+}
+
+// Order in which the inputs are analysed. Every prefix of it is a random
+// sample; with Stratified the inputs of each directory are spread evenly
+// over the order, so every prefix holds each directory in proportion.
+inline std::vector<size_t> SampleOrder(const std::vector<std::string>& Inputs, uint64_t Seed, bool Stratified) {
+    Random Rng(Seed);
+    std::vector<size_t> Order(Inputs.size());
+    for (size_t Index = 0; Index < Order.size(); ++Index)
+        Order[Index] = Index;
+    for (size_t Index = Order.size(); Index > 1; --Index)
+        std::swap(Order[Index - 1], Order[Rng.Below(Index)]);
+
+    if (!Stratified)
+        return Order;
+
+    // Systematic allocation: the k-th of the n inputs of a directory sits
+    // at (k + u) / n, with a random phase u per directory
+    struct Stratum {
+        size_t Size = 0;
+        size_t Taken = 0;
+        double Phase = 0;
+    };
+    std::unordered_map<std::string, Stratum> Strata;
+    std::vector<Stratum*> StratumOf(Inputs.size());
+    for (size_t Index : Order) {
+        const std::string& Path = Inputs[Index];
+        auto [Iter, Inserted] = Strata.try_emplace(Path.substr(0, Path.find_last_of('/') + 1));
+        if (Inserted)
+            Iter->second.Phase = Rng.Unit();
+        Iter->second.Size++;
+        StratumOf[Index] = &Iter->second;
+    }
+
+    std::vector<std::pair<double, size_t>> Keys;
+    for (size_t Index : Order) {
+        Stratum* Stratum = StratumOf[Index];
+        Keys.push_back({(Stratum->Taken++ + Stratum->Phase) / Stratum->Size, Index});
+    }
+    std::stable_sort(Keys.begin(), Keys.end(),
+                     [](const auto& Left, const auto& Right) { return Left.first < Right.first; });
+
+    for (size_t Index = 0; Index < Keys.size(); ++Index)
+        Order[Index] = Keys[Index].second;
+    return Order;
+}
+
+// Keeps every one of Count classes with probability Fraction. The mask is
+// applied before coupling is counted (Project::Records), so CF relates the
+// couplings among kept classes to the pairs of kept classes.
+inline std::vector<bool> SampleClasses(size_t Count, double Fraction, uint64_t Seed) {
+    std::vector<bool> Keep(Count, true);
+    if (Fraction >= 1)
+        return Keep;
+    Random Rng(Seed);
+    for (size_t Index = 0; Index < Count; ++Index)
+        Keep[Index] = Rng.Unit() < Fraction;
+    return Keep;
+}
+
+// Factors of a sample of class records with percentile bootstrap intervals:
+// the records are resampled with replacement Replicates times and every
+// factor's interval spans the middle Confidence of the replicate values
+struct Estimate {
+public:
+    Factors Point;
+    FactorIntervals Intervals;
+    size_t Classes = 0;
+
+private:
+    static std::array<double, 6> Values(const Factors& Result) {
+        return {Result.MethodHiding,  Result.AttributeHiding, Result.MethodInheritance,
+                Result.AttributeInheritance, Result.Polymorphism, Result.Coupling};
+    }
+
+public:
+    Estimate(const std::vector<ClassRecord>& Records, size_t Replicates, double Confidence, uint64_t Seed)
+        : Classes(Records.size()) {
+        Point = Reduce(Records).Finish();
+
+        // Factors without a denominator in a replicate (NaN) are left out
+        std::array<std::vector<double>, 6> Samples;
+        Random Rng(Seed);
+        for (size_t Replicate = 0; Replicate < Replicates && !Records.empty(); ++Replicate) {
+            Sums Sums;
+            for (size_t Draw = 0; Draw < Records.size(); ++Draw)
+                Sums.Add(Records[Rng.Below(Records.size())]);
+            auto Replica = Values(Sums.Finish());
+            for (size_t Factor = 0; Factor < Replica.size(); ++Factor)
+                if (!std::isnan(Replica[Factor]))
+                    Samples[Factor].push_back(Replica[Factor]);
+        }
+
+        double Tail = (1 - Confidence) / 2;
+        auto Estimates = Values(Point);
+        for (size_t Factor = 0; Factor < Samples.size(); ++Factor) {
+            auto& Sample = Samples[Factor];
+            if (Sample.empty()) {
+                Intervals[Factor] = {Estimates[Factor], Estimates[Factor]};
+                continue;
+            }
+            std::sort(Sample.begin(), Sample.end());
+            size_t Last = Sample.size() - 1;
+            Intervals[Factor].Low = Sample[static_cast<size_t>(std::floor(Tail * Last))];
+            Intervals[Factor].High = Sample[static_cast<size_t>(std::ceil((1 - Tail) * Last))];
+        }
+    }
+
+public:
+    // Widest half-interval over the six factors
+    double HalfWidth() const {
+        double Width = 0;
+        for (const Interval& Interval : Intervals)
+            Width = std::max(Width, (Interval.High - Interval.Low) / 2);
+        return Width;
+    }
+};
+
+}
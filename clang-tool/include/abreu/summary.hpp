@@ -0,0 +1,193 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "coupling.hpp"
+#include "hierarchy.hpp"
+#include "metrics.hpp"
+#include "outliers.hpp"
+
+namespace abreu {
+
+// What the factors need from one class once its AST is gone: the counts
+// of its own members and, by USR, the classes it inherits from and uses
+struct ClassSummary {
+    // Of the class itself, of the specialization for an instantiation
+    std::string Usr;
+    // For an instantiation, the USR of its pattern, which is what bases and
+    // suppliers refer to; empty otherwise
+    std::string Pattern;
+    // Qualified name, for reports
+    std::string Name;
+    // Derived, Depth, Children and References are left to the Project
+    ClassRecord Counts;
+    std::vector<std::string> Bases;
+    std::vector<std::string> Suppliers;
+};
+
+// Summaries of every translation unit of a program. A class defined in a
+// header is seen by every TU including it and is counted once, from the
+// first summary; inheritance and coupling then span all TUs. Instantiations
+// are told apart by their own USR, so each distinct one counts once, as in
+// a single TU; references to a template go to its first instantiation.
+struct Project {
+private:
+    std::vector<ClassSummary> Classes;
+    std::unordered_map<std::string, uint32_t> Indices;
+    // What bases and suppliers resolve to: classes by their USR, templates
+    // by their pattern's
+    std::unordered_map<std::string, uint32_t> Referents;
+
+public:
+    void Add(std::vector<ClassSummary> Summaries) {
+        for (auto& Summary : Summaries) {
+            auto [Iter, Inserted] = Indices.try_emplace(Summary.Usr, Classes.size());
+            if (!Inserted)
+                continue;
+            Referents.try_emplace(Summary.Pattern.empty() ? Summary.Usr : Summary.Pattern, Classes.size());
+            Classes.push_back(std::move(Summary));
+        }
+    }
+
+    size_t size() const { return Classes.size(); }
+
+private:
+    // Every count of a record, in declaration order
+    static constexpr int ClassRecord::*Fields[] = {&ClassRecord::NewVisibleMethods,
+                                                   &ClassRecord::NewHiddenMethods,
+                                                   &ClassRecord::NewVisibleAttributes,
+                                                   &ClassRecord::NewHiddenAttributes,
+                                                   &ClassRecord::InheritedNotOverrideMethods,
+                                                   &ClassRecord::InheritedOverrideMethods,
+                                                   &ClassRecord::NewMethods,
+                                                   &ClassRecord::InheritedNotOverrideAttributes,
+                                                   &ClassRecord::InheritedOverrideAttributes,
+                                                   &ClassRecord::NewAttributes,
+                                                   &ClassRecord::Derived,
+                                                   &ClassRecord::References,
+                                                   &ClassRecord::Depth,
+                                                   &ClassRecord::Children};
+
+public:
+    static constexpr const char* Header = "clang-abreu summaries 2";
+
+    // One line per class ("class", USR, name, counts) followed by its
+    // "pattern", "base" and "supplier" lines, tab-separated; USRs and
+    // qualified names never contain tabs or newlines
+    void Write(std::ostream& out) const {
+        out << Header << '\n';
+        for (const auto& Summary : Classes) {
+            out << "class\t" << Summary.Usr << '\t' << Summary.Name;
+            for (auto Field : Fields)
+                out << '\t' << Summary.Counts.*Field;
+            out << '\n';
+            if (!Summary.Pattern.empty())
+                out << "pattern\t" << Summary.Pattern << '\n';
+            for (const auto& Usr : Summary.Bases)
+                out << "base\t" << Usr << '\n';
+            for (const auto& Usr : Summary.Suppliers)
+                out << "supplier\t" << Usr << '\n';
+        }
+    }
+
+    // Merges summaries written by Write, as Add does
+    bool Read(std::istream& in) {
+        std::string Line;
+        if (!std::getline(in, Line) || Line != Header)
+            return false;
+
+        std::vector<ClassSummary> Summaries;
+        while (std::getline(in, Line)) {
+            std::istringstream Columns(Line);
+            std::string Kind;
+            std::getline(Columns, Kind, '\t');
+            if (Kind == "class") {
+                ClassSummary Summary;
+                std::getline(Columns, Summary.Usr, '\t');
+                std::getline(Columns, Summary.Name, '\t');
+                for (auto Field : Fields)
+                    Columns >> Summary.Counts.*Field;
+                if (!Columns)
+                    return false;
+                Summaries.push_back(std::move(Summary));
+                continue;
+            }
+
+            std::string Usr;
+            std::getline(Columns, Usr);
+            if (Summaries.empty())
+                return false;
+            if (Kind == "pattern")
+                Summaries.back().Pattern = Usr;
+            else if (Kind == "base")
+                Summaries.back().Bases.push_back(Usr);
+            else if (Kind == "supplier")
+                Summaries.back().Suppliers.push_back(Usr);
+            else
+                return false;
+        }
+        Add(std::move(Summaries));
+        return true;
+    }
+
+private:
+    // Classes referred to but never summarised (system headers, filtered
+    // out) do not take part, as within a single Context; neither do
+    // classes Keep drops
+    template <typename Member>
+    std::vector<std::pair<uint32_t, uint32_t>> Edges(Member Targets, const std::vector<bool>* Keep = nullptr) const {
+        std::vector<std::pair<uint32_t, uint32_t>> Result;
+        for (size_t Index = 0; Index < Classes.size(); ++Index) {
+            if (Keep && !(*Keep)[Index])
+                continue;
+            for (const auto& Usr : Classes[Index].*Targets) {
+                auto Found = Referents.find(Usr);
+                if (Found != Referents.end() && (!Keep || (*Keep)[Found->second]))
+                    Result.emplace_back(Index, Found->second);
+            }
+        }
+        return Result;
+    }
+
+public:
+    // Records of the classes Keep selects, all without it. Coupling counts
+    // only suppliers that are kept as well, so a sample's CF estimates the
+    // whole program's; descendants and depth are properties of the class in
+    // the whole hierarchy and use every class.
+    std::vector<ClassRecord> Records(const std::vector<bool>* Keep = nullptr) const {
+        CouplingMatrix Coupling(Classes.size(), Edges(&ClassSummary::Suppliers, Keep));
+        HierarchyIndex Hierarchy(Classes.size(), Edges(&ClassSummary::Bases));
+
+        std::vector<ClassRecord> Result;
+        Result.reserve(Classes.size());
+        for (size_t Index = 0; Index < Classes.size(); ++Index) {
+            if (Keep && !(*Keep)[Index])
+                continue;
+            ClassRecord Record = Classes[Index].Counts;
+            Record.References = Coupling.RowCount(Index);
+            Record.Derived = Hierarchy.Descendants(Index);
+            Record.Depth = Hierarchy.Depth(Index);
+            Record.Children = Hierarchy.Children(Index);
+            Result.push_back(Record);
+        }
+        return Result;
+    }
+
+    Factors Compute() const {
+        return Reduce(Records()).Finish();
+    }
+
+    // Takes all records at once, see Outliers
+    void Report(Outliers& Report) const {
+        std::vector<ClassRecord> Records = this->Records();
+        for (size_t Index = 0; Index < Records.size(); ++Index)
+            Report.Add(Records[Index], Classes[Index].Name);
+    }
+};
+
+}
@@ -7,21 +7,64 @@
 
 struct ControlFlowAction : clang::ASTFrontendAction
 {
+private:
+  ToolOptions Options;
+
 public:
+  explicit ControlFlowAction(const ToolOptions &Options = {}) : Options(Options) {}
+
   virtual std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(clang::CompilerInstance &Compiler,
                                                                 llvm::StringRef InFile)
   {
-    return std::make_unique<ControlFlowConsumer>(&Compiler.getASTContext());
+    return std::make_unique<ControlFlowConsumer>(&Compiler.getASTContext(), Options);
+  }
+};
+
+struct UnifiedAction : clang::ASTFrontendAction
+{
+private:
+  ToolOptions Options;
+
+public:
+  explicit UnifiedAction(const ToolOptions &Options = {}) : Options(Options) {}
+
+  virtual std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(clang::CompilerInstance &Compiler,
+                                                                llvm::StringRef InFile)
+  {
+    return std::make_unique<UnifiedConsumer>(&Compiler.getASTContext(), Options);
   }
 };
 
 struct AbreuAction : clang::ASTFrontendAction
 {
+private:
+  ToolOptions Options;
+
 public:
+  explicit AbreuAction(const ToolOptions &Options = {}) : Options(Options) {}
+
+  bool BeginInvocation(clang::CompilerInstance &Compiler) override
+  {
+    // Free the AST at the end of the TU even where the driver asked to
+    // leak it; batch runs keep only the class summaries
+    Compiler.getFrontendOpts().DisableFree = false;
+
+    if (Options.SkipFunctionBodies) {
+      // ParseAST skips every body that is not needed for the declarations
+      // themselves (constexpr and deduced return types are still parsed)
+      Compiler.getFrontendOpts().SkipFunctionBodies = true;
+
+      // Keep template bodies as token streams as well. Off by default:
+      // it changes name lookup the way MSVC does
+      if (Options.DelayedTemplateParsing)
+        Compiler.getLangOpts().DelayedTemplateParsing = true;
+    }
+    return true;
+  }
+
   virtual std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(clang::CompilerInstance &Compiler,
                                                                 llvm::StringRef InFile)
   {
-    std::cout << "Hello!" << std::endl;
-    return std::make_unique<AbreuConsumer>(&Compiler.getASTContext());
+    return std::make_unique<AbreuConsumer>(&Compiler.getASTContext(), Options);
   }
 };
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+
+#include "abreu/metrics.hpp"
+#include "control_flow/call_graph.hpp"
+#include "control_flow/loops.hpp"
+#include "options.hpp"
+
+namespace clang {
+class ASTContext;
+}
+
+// In-process interface of libclangcfgabreu. Results own all their data and
+// refer to neither the AST nor the library, and the library keeps no state
+// between calls, so analyses may run concurrently on separate threads.
+namespace clangcfgabreu {
+
+// Flow graph of one function. Nodes are numbered in preorder (true branch
+// first); node 0 is the call node the function is entered through.
+struct FunctionGraph {
+    struct Node {
+        std::string Label;
+        std::string Shape;
+        // Node ids of the successors, -1 when absent
+        int SuccT = -1;
+        int SuccF = -1;
+    };
+
+    std::vector<Node> Nodes;
+
+    // Per node: number of enclosing loops and innermost loop (-1 outside)
+    std::vector<int> LoopDepth;
+    std::vector<int> LoopOf;
+    std::vector<cfg::graphiz::LoopForest::Loop> Loops;
+
+    // Structural hashes, with and without the statement text
+    uint64_t Fingerprint = 0;
+    uint64_t StructuralFingerprint = 0;
+};
+
+struct Analysis {
+    std::vector<FunctionGraph> Functions;
+    // Functions whose control flow could not be built
+    std::vector<std::string> Unsupported;
+    // The same graphs as the clang-cfg DOT output
+    std::string Dot;
+    cfg::CallGraph Calls;
+
+    abreu::Factors Metrics;
+};
+
+// Analyses the translation unit of an already parsed AST. Options select
+// the declarations (filters, templates), the CFG backend and coalescing.
+Analysis Analyze(clang::ASTContext &Context, const ToolOptions &Options = {});
+
+// Parses Code as if it were the file FileName (relative includes resolve
+// next to it) with the extra compiler Args, then analyses it. Returns false
+// and sets Error when the frontend fails.
+bool AnalyzeBuffer(llvm::StringRef Code, llvm::StringRef FileName, Analysis &Result, std::string &Error,
+                   const ToolOptions &Options = {}, const std::vector<std::string> &Args = {});
+
+// Same for a file on disk
+bool AnalyzeFile(llvm::StringRef Path, Analysis &Result, std::string &Error, const ToolOptions &Options = {},
+                 const std::vector<std::string> &Args = {});
+
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CRC.h"
+#include "llvm/Support/Compression.h"
+
+#include "options.hpp"
+
+// Output is compressed in independent blocks, one per worker at a time.
+// Concatenated gzip members and concatenated zstd frames are both valid
+// streams, so the blocks are simply written one after another and the
+// result reads back with plain gzip -d / zstd -d.
+namespace compress {
+
+static constexpr size_t BlockSize = 1 << 20;
+
+inline bool Available(Compression Kind, std::string &Error) {
+    switch (Kind) {
+    case Compression::None:
+        return true;
+    case Compression::Zlib:
+        if (llvm::compression::zlib::isAvailable())
+            return true;
+        Error = "LLVM собран без поддержки zlib";
+        return false;
+    case Compression::Zstd:
+        if (llvm::compression::zstd::isAvailable())
+            return true;
+        Error = "LLVM собран без поддержки zstd";
+        return false;
+    }
+    return false;
+}
+
+inline const char *Suffix(Compression Kind) {
+    switch (Kind) {
+    case Compression::Zlib:
+        return ".gz";
+    case Compression::Zstd:
+        return ".zst";
+    default:
+        return "";
+    }
+}
+
+// Path with the suffix of the format appended unless it is there already
+inline std::string OutputPath(const std::string &Path, Compression Kind) {
+    llvm::StringRef Ext = Suffix(Kind);
+    return llvm::StringRef(Path).ends_with(Ext) ? Path : Path + Ext.str();
+}
+
+namespace detail {
+
+inline void PutLE32(std::string &Out, uint32_t Value) {
+    for (int Byte = 0; Byte < 4; ++Byte)
+        Out.push_back(char(Value >> (8 * Byte) & 0xff));
+}
+
+// LLVM produces a zlib stream: 2 header bytes, raw deflate, Adler-32.
+// The deflate data is rewrapped as a gzip member (RFC 1952).
+inline std::string GzipMember(llvm::ArrayRef<uint8_t> Input) {
+    llvm::SmallVector<uint8_t, 0> Zlib;
+    llvm::compression::zlib::compress(Input, Zlib);
+
+    static const char Header[] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, 3};
+    std::string Member(Header, sizeof(Header));
+    Member.append(reinterpret_cast<const char *>(Zlib.data()) + 2, Zlib.size() - 6);
+    PutLE32(Member, llvm::crc32(Input));
+    PutLE32(Member, uint32_t(Input.size()));
+    return Member;
+}
+
+inline std::string ZstdFrame(llvm::ArrayRef<uint8_t> Input) {
+    llvm::SmallVector<uint8_t, 0> Frame;
+    llvm::compression::zstd::compress(Input, Frame);
+    return std::string(Frame.begin(), Frame.end());
+}
+
+}
+
+// Compresses the concatenation of Chunks; the result is a list of blocks
+// ready for a vectored write. Threads == 0 uses every hardware thread.
+inline std::vector<std::string> Compress(std::vector<std::string> Chunks, Compression Kind, unsigned Threads = 0) {
+    if (Kind == Compression::None)
+        return Chunks;
+
+    // Cut the text into fixed-size blocks, across chunk boundaries
+    std::vector<std::string> Blocks(1);
+    for (const auto &Chunk : Chunks) {
+        for (size_t Offset = 0; Offset < Chunk.size();) {
+            if (Blocks.back().size() == BlockSize)
+                Blocks.emplace_back();
+            size_t Step = std::min(Chunk.size() - Offset, BlockSize - Blocks.back().size());
+            Blocks.back().append(Chunk, Offset, Step);
+            Offset += Step;
+        }
+    }
+    Chunks.clear();
+
+    std::vector<std::string> Result(Blocks.size());
+    std::atomic<size_t> Next{0};
+    auto Work = [&] {
+        for (size_t Block; (Block = Next++) < Blocks.size();) {
+            auto Input = llvm::arrayRefFromStringRef(Blocks[Block]);
+            Result[Block] = Kind == Compression::Zlib ? detail::GzipMember(Input) : detail::ZstdFrame(Input);
+            std::string().swap(Blocks[Block]);
+        }
+    };
+
+    if (!Threads)
+        Threads = std::max(1u, std::thread::hardware_concurrency());
+    Threads = std::min<size_t>(Threads, Blocks.size());
+
+    std::vector<std::thread> Workers;
+    for (unsigned Worker = 1; Worker < Threads; ++Worker)
+        Workers.emplace_back(Work);
+    Work();
+    for (auto &Worker : Workers)
+        Worker.join();
+
+    return Result;
+}
+
+}
@@ -2,24 +2,128 @@
 
 #include "clang/AST/ASTConsumer.h"
 
+#include "compress.hpp"
+#include "options.hpp"
 #include "visitor.hpp"
+#include "writer.hpp"
 
 #include <iostream>
 #include <fstream>
+#include <iterator>
+#include <sstream>
+
+// Compresses the output if asked to and hands it to the writer thread, or
+// writes it right away when there is none
+inline void Emit(const ToolOptions &Options, const std::string &Path, std::vector<std::string> Chunks) {
+  Chunks = compress::Compress(std::move(Chunks), Options.Compress, Options.CompressThreads);
+  if (Options.Writer) {
+    Options.Writer->Write(Path, std::move(Chunks));
+    return;
+  }
+
+  std::ofstream ofstream(Path, std::ios::binary);
+  for (const auto &Chunk : Chunks)
+    ofstream << Chunk;
+}
+
+// Factors of a unit's abreu::Context or of a merged abreu::Project and,
+// when a path is given, the outlier report; the factors go to stdout when
+// MetricsOutput is empty
+template <typename Source>
+inline void EmitMetrics(const Source &Classes, const ToolOptions &Options) {
+  if (!Options.ReportOutput.empty()) {
+    abreu::Outliers Report(Options.TopK);
+    Classes.Report(Report);
+    std::ostringstream out;
+    Report.Print(out);
+    Emit(Options, Options.ReportOutput, {out.str()});
+  }
+
+  std::ostringstream out;
+  abreu::Print(Classes.Compute(), out);
+  if (Options.MetricsOutput.empty())
+    std::cout << out.str();
+  else
+    Emit(Options, Options.MetricsOutput, {out.str()});
+}
+
+inline void EmitCallGraph(const cfg::CallGraph &Calls, const ToolOptions &Options, std::ostream &out) {
+  out << "Call graph: " << Calls.size() << " functions, " << Calls.edgeCount() << " calls, "
+      << Calls.componentCount() << " components\n";
+  Emit(Options, Options.CallGraphOutput,
+       {Options.CallGraph == CallGraphFormat::Binary ? Calls.Binary() : Calls.Dot()});
+}
 
 struct ControlFlowConsumer : clang::ASTConsumer 
 {
-private:
+protected:
   Visitor Visitor;
+  ToolOptions Options;
 
 public:
-  explicit ControlFlowConsumer(ASTContext *Context) : Visitor(Context) {}
+  explicit ControlFlowConsumer(ASTContext *Context, const ToolOptions &Options)
+    : Visitor(Context, Options, true), Options(Options) {}
 
   void HandleTranslationUnit(clang::ASTContext &Context) override {
+    // Messages go out at once when the unit is done, so those of units
+    // analysed in parallel do not interleave
+    std::ostringstream out;
+    std::ostringstream err;
+
     Visitor.TraverseDecl(Context.getTranslationUnitDecl());
+    Visitor.BuildPending();
+    for (const auto &Name : Visitor.Unsupported)
+      err << "Unsupported control flow in " << Name << '\n';
+
+    // Before coalescing, which leaves absorbed nodes behind unlinked
+    std::vector<std::string> DataflowChunks;
+    if (Options.Dataflow) {
+      cfg::Context::DataflowTotals Totals;
+      std::vector<std::string> Warnings;
+      DataflowChunks = Visitor.RenderDataflow(Totals, Warnings);
+      for (const auto &Warning : Warnings)
+        err << "warning: " << Warning << '\n';
+      out << "Dataflow: " << Totals.Variables << " variables, " << Totals.Definitions
+          << " definitions, unreachable nodes: " << Totals.Unreachable << '\n';
+    }
+
+    if (Options.Coalesce) {
+      auto Stats = Visitor.Coalesce();
+      out << "Coalesced nodes: " << Stats.NodesBefore << " -> " << Stats.NodesAfter
+          << ", edges: " << Stats.EdgesBefore << " -> " << Stats.EdgesAfter
+          << " (ratio " << Stats.Ratio() << ")\n";
+    }
+
+    Emit(Options, Options.Output, Visitor.Render());
+
+    if (Options.Loops) {
+      cfg::Context::LoopTotals Totals;
+      auto Chunks = Visitor.RenderLoops(Totals);
+      out << "Loops: " << Totals.Loops << " (irreducible: " << Totals.Irreducible
+          << "), max depth: " << Totals.MaxDepth << '\n';
+      if (!Options.LoopsOutput.empty())
+        Emit(Options, Options.LoopsOutput, std::move(Chunks));
+    }
 
-    std::ofstream ofstream("graph.dot");
-    Visitor.Draw(ofstream);
+    if (!Options.DataflowOutput.empty())
+      Emit(Options, Options.DataflowOutput, std::move(DataflowChunks));
+
+    if (!Options.FingerprintOutput.empty()) {
+      auto Index = Visitor.Fingerprints(Options.FingerprintLabels);
+      size_t Duplicates = 0;
+      size_t Buckets = Index.Buckets(Duplicates);
+      out << "Fingerprints: " << Index.Entries.size() << " functions, " << Duplicates
+          << " in " << Buckets << " shared buckets\n";
+      Emit(Options, Options.FingerprintOutput, {Index.Render()});
+    }
+
+    if (Options.Calls)
+      *Options.Calls = Visitor.Cfg().Calls.Edges();
+    else if (!Options.CallGraphOutput.empty())
+      EmitCallGraph(Visitor.Calls(), Options, out);
+
+    std::cerr << err.str();
+    std::cout << out.str();
   }
 };
 
@@ -27,13 +131,47 @@ struct AbreuConsumer : clang::ASTConsumer
 {
 private:
   Visitor Visitor;
+  ToolOptions Options;
 
 public:
-  explicit AbreuConsumer(ASTContext *Context) : Visitor(Context) {}
+  explicit AbreuConsumer(ASTContext *Context, const ToolOptions &Options)
+    : Visitor(Context, Options), Options(Options) {}
 
   void HandleTranslationUnit(clang::ASTContext &Context) override {
     Visitor.TraverseDecl(Context.getTranslationUnitDecl());
 
-    Visitor.Stats();
+    // Only the summaries outlive the TU, the AST is freed right after
+    if (Options.Summaries) {
+      auto Summaries = Visitor.Abreu().Summaries();
+      std::move(Summaries.begin(), Summaries.end(), std::back_inserter(*Options.Summaries));
+      return;
+    }
+
+    EmitMetrics(Visitor.Abreu(), Options);
+  }
+};
+
+// clang-cfg --metrics: the traversal building the graphs collects the
+// classes as well, so both results come from a single parse. Bodies count
+// as in clang-abreu (see SkipFunctionBodies), but the path filters are the
+// graphs' own: the factors match clang-abreu's only with
+// --main-file-only=false. In batch mode the summaries go to
+// Options.Summaries and the factors are computed once over the merged
+// project, as clang-abreu does.
+struct UnifiedConsumer : ControlFlowConsumer
+{
+public:
+  using ControlFlowConsumer::ControlFlowConsumer;
+
+  void HandleTranslationUnit(clang::ASTContext &Context) override {
+    ControlFlowConsumer::HandleTranslationUnit(Context);
+
+    if (Options.Summaries) {
+      auto Summaries = Visitor.Abreu().Summaries();
+      std::move(Summaries.begin(), Summaries.end(), std::back_inserter(*Options.Summaries));
+      return;
+    }
+
+    EmitMetrics(Visitor.Abreu(), Options);
   }
 };
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+namespace cfg {
+
+// Owns the nodes of one analysis (flow nodes and the syntax nodes that
+// link them). Nodes point at each other freely, so they are released
+// together, in reverse order of creation, when the arena goes away.
+struct Arena {
+private:
+    std::vector<std::pair<void*, void (*)(void*)>> Objects;
+
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&& Other) noexcept : Objects(std::move(Other.Objects)) { Other.Objects.clear(); }
+
+    ~Arena() {
+        for (auto Iter = Objects.rbegin(); Iter != Objects.rend(); ++Iter)
+            Iter->second(Iter->first);
+    }
+
+public:
+    template <typename T, typename... Args>
+    T* Make(Args&&... args) {
+        T* Object = new T(std::forward<Args>(args)...);
+        Objects.push_back({Object, [](void* Ptr) { delete static_cast<T*>(Ptr); }});
+        return Object;
+    }
+
+    // Takes over the objects of an arena filled on another thread
+    void Adopt(Arena&& Other) {
+        Objects.insert(Objects.end(), Other.Objects.begin(), Other.Objects.end());
+        Other.Objects.clear();
+    }
+};
+
+}
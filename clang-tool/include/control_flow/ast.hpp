@@ -8,13 +8,14 @@
 #include <stack>
 #include <numeric>
 
+#include "arena.hpp"
 #include "graphiz.hpp"
 
 namespace cfg {
 
 namespace ast {
 
-std::string prettyStmt(clang::Stmt* stmt, clang::ASTContext* Context) {
+inline std::string prettyStmt(const clang::Stmt* stmt, clang::ASTContext* Context) {
     if (!stmt)
         return "";
     std::string res;
@@ -23,65 +24,116 @@ std::string prettyStmt(clang::Stmt* stmt, clang::ASTContext* Context) {
     return res;
 }
 
-bool ForReached = false;
-std::stack<std::vector<graphiz::FlowNode*>> BreakSubjectT;
-std::stack<std::vector<graphiz::FlowNode*>> BreakSubjectF;
+inline std::string prettyDecl(const clang::DeclStmt* DeclStmt, clang::ASTContext* Context) {
+    std::string res;
+    for (auto Iter = DeclStmt->decl_begin(); Iter != DeclStmt->decl_end(); ++Iter) {
+        if (const auto* varDecl = llvm::dyn_cast<clang::VarDecl>(*Iter)) {
+            std::string VarName = varDecl->getNameAsString();
 
-void PushBreak() {
-    ForReached = false;
-    BreakSubjectT.push({});
-    BreakSubjectF.push({});
-}
+            const clang::Expr *InitExpr = varDecl->getInit();
+            if (!InitExpr)
+                continue;
+            std::string InitStr = prettyStmt(InitExpr, Context);
 
-void PushBreakSubjectT(graphiz::FlowNode* Subject) {
-    assert(BreakSubjectT.empty() != true);
-    BreakSubjectT.top().push_back(Subject);
+            res += VarName + " = " + InitStr + '\n';
+        }
+    }
+    return res;
 }
 
-void PushBreakSubjectF(graphiz::FlowNode* Subject) {
-    assert(BreakSubjectF.empty() != true);
-    BreakSubjectF.top().push_back(Subject);
+inline graphiz::Call* makeCall(clang::FunctionDecl* FuncDecl, Arena& Nodes) {
+    std::vector<std::string> CallParams = {};
+    for (auto iter = FuncDecl->param_begin(); iter != FuncDecl->param_end(); ++iter) {
+        CallParams.push_back((*iter)->getName().data());
+    }
+    std::string CallName = FuncDecl->getNameInfo().getAsString();
+
+    return Nodes.Make<graphiz::Call>(CallName, CallParams);
 }
 
-std::stack<graphiz::Statement*> ContinueAssignee;
-std::stack<graphiz::FlowNode*> ContinueSubject;
+// Pending break and continue edges of the loops being built. Every
+// function is built with a state of its own, so builds do not share
+// anything but the arena they allocate from.
+struct BuildState {
+public:
+    Arena& Nodes;
 
-void PushContinueAsignee(graphiz::Statement* Asignee) {
-    ContinueAssignee.push(Asignee);
-}
+    bool ForReached = false;
+    std::stack<std::vector<graphiz::FlowNode*>> BreakSubjectT;
+    std::stack<std::vector<graphiz::FlowNode*>> BreakSubjectF;
 
-void PopContinueAsignee() {
-    assert(ContinueAssignee.empty() != true);
+    std::stack<graphiz::Statement*> ContinueAssignee;
+    std::stack<graphiz::FlowNode*> ContinueSubject;
 
-    ContinueAssignee.pop();
-}
+    // Every flow node of the function, reachable or not
+    std::vector<graphiz::FlowNode*> Created;
+
+public:
+    explicit BuildState(Arena& Nodes) : Nodes(Nodes) {}
 
-graphiz::Statement* TopContinueAsignee() {
-    assert(ContinueAssignee.empty() != true);
+public:
+    template <typename T>
+    T* NewNode(const std::string& Label, const clang::Stmt* Source) {
+        T* Node = Nodes.Make<T>(Label);
+        Node->Stmts.push_back(Source);
+        Created.push_back(Node);
+        return Node;
+    }
 
-    graphiz::Statement* TopAssignee = ContinueAssignee.top();
-    assert(TopAssignee != nullptr);
+public:
+    void PushBreak() {
+        ForReached = false;
+        BreakSubjectT.push({});
+        BreakSubjectF.push({});
+    }
 
-    return TopAssignee;
-};
+    void PushBreakSubjectT(graphiz::FlowNode* Subject) {
+        assert(BreakSubjectT.empty() != true);
+        BreakSubjectT.top().push_back(Subject);
+    }
 
-void PushContinueSubject(graphiz::FlowNode* Subject) {
-    ContinueSubject.push(Subject);
-}
+    void PushBreakSubjectF(graphiz::FlowNode* Subject) {
+        assert(BreakSubjectF.empty() != true);
+        BreakSubjectF.top().push_back(Subject);
+    }
+
+    void PushContinueAsignee(graphiz::Statement* Asignee) {
+        ContinueAssignee.push(Asignee);
+    }
 
-void PopContinueSubject() {
-    assert(ContinueSubject.empty() != true);
+    void PopContinueAsignee() {
+        assert(ContinueAssignee.empty() != true);
 
-    ContinueSubject.pop();
-}
+        ContinueAssignee.pop();
+    }
 
-graphiz::FlowNode* TopContinueSubject() {
-    assert(ContinueSubject.empty() != true);
+    graphiz::Statement* TopContinueAsignee() {
+        assert(ContinueAssignee.empty() != true);
 
-    graphiz::FlowNode* TopAssignee = ContinueSubject.top();
-    assert(TopAssignee != nullptr);
+        graphiz::Statement* TopAssignee = ContinueAssignee.top();
+        assert(TopAssignee != nullptr);
 
-    return TopAssignee;
+        return TopAssignee;
+    }
+
+    void PushContinueSubject(graphiz::FlowNode* Subject) {
+        ContinueSubject.push(Subject);
+    }
+
+    void PopContinueSubject() {
+        assert(ContinueSubject.empty() != true);
+
+        ContinueSubject.pop();
+    }
+
+    graphiz::FlowNode* TopContinueSubject() {
+        assert(ContinueSubject.empty() != true);
+
+        graphiz::FlowNode* TopAssignee = ContinueSubject.top();
+        assert(TopAssignee != nullptr);
+
+        return TopAssignee;
+    }
 };
 
 enum class CompoundType {
@@ -100,6 +152,9 @@ public:
     virtual graphiz::FlowNode* FlowStart() const = 0;
     virtual std::vector<graphiz::FlowNode*> FlowEnd() const = 0;
 
+    // Functions only: all flow nodes built, including unreachable ones
+    virtual std::vector<graphiz::FlowNode*> FlowNodes() const { return {}; }
+
 public:
     virtual void Assign(graphiz::Statement* ContNode) { assert(false); };
 
@@ -107,15 +162,15 @@ public:
     virtual ~Node() {};
 };
 
-Node* CreateNode(clang::Stmt* Stmt, clang::ASTContext* Context, CompoundType Type = CompoundType::If);
+Node* CreateNode(clang::Stmt* Stmt, clang::ASTContext* Context, BuildState& State, CompoundType Type = CompoundType::If);
 
 struct Operator : Node {
 private:
     graphiz::Statement* FlowNode = nullptr;
 
 public:
-    Operator(clang::Expr* Op, clang::ASTContext* Context) {
-        FlowNode = new graphiz::Statement(prettyStmt(Op, Context));
+    Operator(clang::Expr* Op, clang::ASTContext* Context, BuildState& State) {
+        FlowNode = State.NewNode<graphiz::Statement>(prettyStmt(Op, Context), Op);
         // std::cout << "CREATED OP" << prettyStmt(Op, Context) << std::endl;
     }
 
@@ -140,8 +195,8 @@ private:
     graphiz::Statement* FlowNode = nullptr;
 
 public:
-    Return(clang::ReturnStmt* RetStmt, clang::ASTContext* Context) {
-        FlowNode = new graphiz::Statement(prettyStmt(RetStmt, Context));
+    Return(clang::ReturnStmt* RetStmt, clang::ASTContext* Context, BuildState& State) {
+        FlowNode = State.NewNode<graphiz::Statement>(prettyStmt(RetStmt, Context), RetStmt);
         // std::cout << "CREATED RET" << prettyStmt(RetStmt, Context) << std::endl;
     }
 
@@ -166,21 +221,8 @@ private:
     graphiz::Statement* FlowNode = nullptr;
 
 public:
-    Decl(clang::DeclStmt* DeclStmt, clang::ASTContext* Context) {
-        FlowNode = new graphiz::Statement("");
-
-        for (auto Iter = DeclStmt->decl_begin(); Iter != DeclStmt->decl_end(); ++Iter) {
-            if (clang::VarDecl* varDecl = llvm::dyn_cast<clang::VarDecl>(*Iter)) {
-                std::string VarName = varDecl->getNameAsString();
-
-                clang::Expr *InitExpr = varDecl->getInit();
-                if (!InitExpr)
-                    continue;
-                std::string InitStr = prettyStmt(InitExpr, Context);
-
-                FlowNode->sourceCode += VarName + " = " + InitStr + '\n';
-            }
-        }
+    Decl(clang::DeclStmt* DeclStmt, clang::ASTContext* Context, BuildState& State) {
+        FlowNode = State.NewNode<graphiz::Statement>(prettyDecl(DeclStmt, Context), DeclStmt);
 
         // std::cout << "CREATED DECL" << prettyStmt(DeclStmt, Context) << std::endl;
     }
@@ -207,23 +249,21 @@ private:
 
 private:
     Node* Body = nullptr;
+    std::vector<graphiz::FlowNode*> Created;
 
 public:
-    Function(clang::FunctionDecl* FuncDecl, clang::ASTContext* Context) {
-        std::vector<std::string> CallParams = {};
-        for (auto iter = FuncDecl->param_begin(); iter != FuncDecl->param_end(); ++iter) {
-            CallParams.push_back((*iter)->getName().data());
-        }
-        std::string CallName = FuncDecl->getNameInfo().getAsString();
-
-        CallFlow = new graphiz::Call(CallName, CallParams);
-        Body = CreateNode(FuncDecl->getBody(), Context);
+    Function(clang::FunctionDecl* FuncDecl, clang::ASTContext* Context, Arena& Nodes) {
+        BuildState State(Nodes);
+        CallFlow = makeCall(FuncDecl, Nodes);
+        Body = CreateNode(FuncDecl->getBody(), Context, State);
 
         if (!Body)
             throw std::exception();
 
         if (Body->FlowStart())
             CallFlow->assign(Body->FlowStart());
+
+        Created = std::move(State.Created);
     }
 
     graphiz::FlowNode* FlowStart() const override { 
@@ -235,6 +275,10 @@ public:
         // std::cout << __LINE__ << std::endl;
         return Body->FlowEnd();
     }
+
+    std::vector<graphiz::FlowNode*> FlowNodes() const override {
+        return Created;
+    }
 };
 
 struct Continue : Node {
@@ -276,17 +320,17 @@ private:
     Node* Else = nullptr;
 
 private:
-    void SetThen(Node* Then_) {
+    void SetThen(Node* Then_, BuildState& State) {
         assert(Then_ != nullptr);
         Then = Then_;
 
         if (Then->IsContinue()) {
-            CondFlow->assignT(TopContinueAsignee());
+            CondFlow->assignT(State.TopContinueAsignee());
             return;
         }
 
         if (Then->IsBreak()) {
-            PushBreakSubjectT(CondFlow);
+            State.PushBreakSubjectT(CondFlow);
             return;
         }
 
@@ -295,17 +339,17 @@ private:
             CondFlow->assignT(Then->FlowStart());
     }
 
-    void SetElse(Node* Else_) {
+    void SetElse(Node* Else_, BuildState& State) {
         assert(Else_ != nullptr);
         Else = Else_;
 
         if (Else->IsContinue()) {
-            CondFlow->assignF(TopContinueAsignee());
+            CondFlow->assignF(State.TopContinueAsignee());
             return;
         }
 
         if (Else->IsBreak()) {
-            PushBreakSubjectF(CondFlow);
+            State.PushBreakSubjectF(CondFlow);
             return;
         }
 
@@ -314,21 +358,21 @@ private:
     }
 
 public:
-    If(clang::IfStmt *IfStmt, clang::ASTContext* Context) {
+    If(clang::IfStmt *IfStmt, clang::ASTContext* Context, BuildState& State) {
         clang::Expr *IfCond = IfStmt->getCond();
         if (!IfCond)
             throw std::exception();
 
-        CondFlow = new graphiz::Condition(prettyStmt(IfCond, Context));
+        CondFlow = State.NewNode<graphiz::Condition>(prettyStmt(IfCond, Context), IfCond);
 
-        PushContinueSubject(CondFlow);
+        State.PushContinueSubject(CondFlow);
         
         if (IfStmt->getThen())
-            SetThen(CreateNode(IfStmt->getThen(), Context, CompoundType::If));
+            SetThen(CreateNode(IfStmt->getThen(), Context, State, CompoundType::If), State);
         if (IfStmt->getElse())
-            SetElse(CreateNode(IfStmt->getElse(), Context, CompoundType::Else));
+            SetElse(CreateNode(IfStmt->getElse(), Context, State, CompoundType::Else), State);
         
-        PopContinueSubject();
+        State.PopContinueSubject();
 
         // std::cout << "CREATED IF" << prettyStmt(IfStmt, Context) << std::endl;
     }
@@ -336,12 +380,10 @@ public:
     bool IsIf() const override { return true; }
 
     graphiz::FlowNode* FlowStart() const override { 
-        std::cout << __LINE__ << std::endl;
         return CondFlow;
     }
 
     std::vector<graphiz::FlowNode*> FlowEnd() const override {
-        std::cout << __LINE__ << std::endl;
         std::vector<graphiz::FlowNode*> res;
 
         auto ThenEnds = Then->FlowEnd();
@@ -376,10 +418,8 @@ private:
             CondFlow->assignT(Body->FlowStart());
 
             auto Ends = Body->FlowEnd();
-            for (auto* End : Ends) {
-                std::cout << "Assign END" << Ends.size() << std::endl;
+            for (auto* End : Ends)
                 End->assign(IncFlow);
-            }
         }
         // Empty braces
         else {
@@ -387,14 +427,12 @@ private:
         }
 
         auto Ends = Body->FlowEnd();
-        for (auto* End : Ends) {
-            std::cout << "Assign END" << Ends.size() << std::endl;
+        for (auto* End : Ends)
             End->assign(IncFlow);
-        }
     }
 
 public:
-    For(clang::ForStmt *ForStmt, clang::ASTContext* Context) {
+    For(clang::ForStmt *ForStmt, clang::ASTContext* Context, BuildState& State) {
         auto *InitStmt = ForStmt->getInit();
         if (!InitStmt)
             throw std::exception();
@@ -408,16 +446,16 @@ public:
         if (!BodyStmt)
             throw std::exception();
 
-        InitFlow = new graphiz::Statement(prettyStmt(InitStmt, Context));
-        CondFlow = new graphiz::Condition(prettyStmt(CondExpr, Context));
-        IncFlow = new graphiz::Statement(prettyStmt(IncExpr, Context));
+        InitFlow = State.NewNode<graphiz::Statement>(prettyStmt(InitStmt, Context), InitStmt);
+        CondFlow = State.NewNode<graphiz::Condition>(prettyStmt(CondExpr, Context), CondExpr);
+        IncFlow = State.NewNode<graphiz::Statement>(prettyStmt(IncExpr, Context), IncExpr);
         
-        PushBreak();
-        PushContinueAsignee(IncFlow);
-        PushContinueSubject(CondFlow);
-        SetBody(CreateNode(BodyStmt, Context, CompoundType::If));
-        PopContinueSubject();
-        PopContinueAsignee();
+        State.PushBreak();
+        State.PushContinueAsignee(IncFlow);
+        State.PushContinueSubject(CondFlow);
+        SetBody(CreateNode(BodyStmt, Context, State, CompoundType::If));
+        State.PopContinueSubject();
+        State.PopContinueAsignee();
 
         InitFlow->assign(CondFlow);
         IncFlow->assign(CondFlow);
@@ -447,19 +485,19 @@ private:
     CompoundType Type;
 
 private:
-    bool PushStmt(Node* Stmt) {
+    bool PushStmt(Node* Stmt, BuildState& State) {
         if (!Stmt) {
             // std::cout << "Push Unknown" << std::endl;
             return true;
         }
         if (Stmt->IsContinue()) {
             if (LastNode)
-                LastNode->Assign(TopContinueAsignee());
+                LastNode->Assign(State.TopContinueAsignee());
             else {
                 if (Type == CompoundType::If)
-                    TopContinueSubject()->assignT(TopContinueAsignee());
+                    State.TopContinueSubject()->assignT(State.TopContinueAsignee());
                 else
-                    TopContinueSubject()->assignF(TopContinueAsignee());
+                    State.TopContinueSubject()->assignF(State.TopContinueAsignee());
             }
             return false;
         }
@@ -467,15 +505,15 @@ private:
             // assert(false);
             if (LastNode) {
                 // assert(false);
-                PushBreakSubjectT(LastNode->FlowStart());
-                PushBreakSubjectF(LastNode->FlowStart());
+                State.PushBreakSubjectT(LastNode->FlowStart());
+                State.PushBreakSubjectF(LastNode->FlowStart());
                 // assert(false);
             }
             else {
                 if (Type == CompoundType::If)
-                    PushBreakSubjectT(TopContinueSubject());
+                    State.PushBreakSubjectT(State.TopContinueSubject());
                 else
-                    PushBreakSubjectF(TopContinueSubject());
+                    State.PushBreakSubjectF(State.TopContinueSubject());
             }
             // assert(false);
             return false;
@@ -483,38 +521,34 @@ private:
 
         // assert(false);
         // Yo prevent fall in braces if in current scope(without breakSubjcts in collection)
-        if (!BreakSubjectT.empty() && !BreakSubjectT.top().empty() && !Stmt->IsIf() && ForReached) {
-            std::cout << "Assign Break (enter)" << std::endl;
+        if (!State.BreakSubjectT.empty() && !State.BreakSubjectT.top().empty() && !Stmt->IsIf() && State.ForReached) {
             if (Stmt->IsFor()) {
                 auto* ForStmt = static_cast<ast::For*>(Stmt);
-                for (auto Subj : BreakSubjectT.top())
+                for (auto Subj : State.BreakSubjectT.top())
                     Subj->assignT(ForStmt->IncFlow);
             }
             else {
-                for (auto Subj : BreakSubjectT.top())
+                for (auto Subj : State.BreakSubjectT.top())
                     Subj->assignT(Stmt->FlowStart());
             }
-            BreakSubjectT.pop();
-            std::cout << "Assign Break (exit)" << std::endl;
+            State.BreakSubjectT.pop();
         }
-        if (!BreakSubjectF.empty() && !BreakSubjectF.top().empty() && !Stmt->IsIf() && ForReached) {
-            std::cout << "Assign Break (enter)" << std::endl;
+        if (!State.BreakSubjectF.empty() && !State.BreakSubjectF.top().empty() && !Stmt->IsIf() && State.ForReached) {
             if (Stmt->IsFor()) {
                 auto* ForStmt = static_cast<ast::For*>(Stmt);
-                for (auto Subj : BreakSubjectF.top())
+                for (auto Subj : State.BreakSubjectF.top())
                     Subj->assignF(ForStmt->IncFlow);
             }
             else {
-                for (auto Subj : BreakSubjectF.top())
+                for (auto Subj : State.BreakSubjectF.top())
                     Subj->assignF(Stmt->FlowStart());
             }
-            BreakSubjectF.pop();
-            std::cout << "Assign Break (exit)" << std::endl;
+            State.BreakSubjectF.pop();
         }
         // assert(false);
 
         if (Stmt->IsFor())
-            ForReached = true;
+            State.ForReached = true;
 
         if (!StartNode)
             StartNode = Stmt;
@@ -529,10 +563,10 @@ private:
     }
 
 public:
-    Compound(clang::CompoundStmt *CompoundStmt, clang::ASTContext* Context, CompoundType Type_) : Type(Type_) {
+    Compound(clang::CompoundStmt *CompoundStmt, clang::ASTContext* Context, BuildState& State, CompoundType Type_) : Type(Type_) {
         for (auto Iter = CompoundStmt->body_begin(); Iter != CompoundStmt->body_end(); ++Iter) {
             // std::cout << "PUSH STMT" << prettyStmt(*Iter, Context) << std::endl;
-            if (PushStmt(CreateNode(*Iter, Context)) == false) {
+            if (PushStmt(CreateNode(*Iter, Context, State), State) == false) {
                 LastNode = nullptr;
                 break;
             }
@@ -559,44 +593,44 @@ public:
     }
 };
 
-Node* CreateNode(clang::Stmt* Stmt, clang::ASTContext* Context, CompoundType Type) {
+inline Node* CreateNode(clang::Stmt* Stmt, clang::ASTContext* Context, BuildState& State, CompoundType Type) {
     assert(Stmt != nullptr);
     // std::cout << "CREATE" << prettyStmt(Stmt, Context) << std::endl;
     if (clang::BinaryOperator* BinOp = llvm::dyn_cast<clang::BinaryOperator>(Stmt)) {
         // std::cout << "CREATE BINOP" << prettyStmt(Stmt, Context) << std::endl;
-        return new Operator(BinOp, Context);
+        return State.Nodes.Make<Operator>(BinOp, Context, State);
     }
     if (clang::UnaryOperator* UnOp = llvm::dyn_cast<clang::UnaryOperator>(Stmt)) {
         // std::cout << "CREATE UNOP" << prettyStmt(Stmt, Context) << std::endl;
-        return new Operator(UnOp, Context);
+        return State.Nodes.Make<Operator>(UnOp, Context, State);
     }
     if (clang::ReturnStmt* RetStmt = llvm::dyn_cast<clang::ReturnStmt>(Stmt)) {
         // std::cout << "CREATE RET" << prettyStmt(Stmt, Context) << std::endl;
-        return new Return(RetStmt, Context);
+        return State.Nodes.Make<Return>(RetStmt, Context, State);
     }
     if (clang::DeclStmt* DeclStmt = llvm::dyn_cast<clang::DeclStmt>(Stmt)) {
         // std::cout << "CREATE DECL" << prettyStmt(Stmt, Context) << std::endl;
-        return new Decl(DeclStmt, Context);
+        return State.Nodes.Make<Decl>(DeclStmt, Context, State);
     }
     if (clang::BreakStmt* BreakStmt = llvm::dyn_cast<clang::BreakStmt>(Stmt)) {
         // std::cout << "CREATE BREAK" << prettyStmt(Stmt, Context) << std::endl;
-        return new Break();
+        return State.Nodes.Make<Break>();
     }
     if (clang::ContinueStmt* ContinueStmt = llvm::dyn_cast<clang::ContinueStmt>(Stmt)) {
         // std::cout << "CREATE CONT" << prettyStmt(Stmt, Context) << std::endl;
-        return new Continue();
+        return State.Nodes.Make<Continue>();
     }
     if (clang::CompoundStmt* CompoundStmt = llvm::dyn_cast<clang::CompoundStmt>(Stmt)) {
         // std::cout << "CREATE CMPD" << prettyStmt(Stmt, Context) << std::endl;
-        return new Compound(CompoundStmt, Context, Type);
+        return State.Nodes.Make<Compound>(CompoundStmt, Context, State, Type);
     }
     if (clang::IfStmt* IfStmt = llvm::dyn_cast<clang::IfStmt>(Stmt)) {
         // std::cout << "CREATE IF" << prettyStmt(Stmt, Context) << std::endl;
-        return new If(IfStmt, Context);
+        return State.Nodes.Make<If>(IfStmt, Context, State);
     }
     if (clang::ForStmt* ForStmt = llvm::dyn_cast<clang::ForStmt>(Stmt)) {
         // std::cout << "CREATE FOR" << prettyStmt(Stmt, Context) << std::endl;
-        return new For(ForStmt, Context);
+        return State.Nodes.Make<For>(ForStmt, Context, State);
     }
 
     // throw std::exception();
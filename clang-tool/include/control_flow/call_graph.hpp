@@ -0,0 +1,256 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cfg {
+
+// Interprocedural call graph over function ids in CSR form, with its
+// strongly connected components and their condensation. Holds no AST
+// pointers, so it outlives the translation unit it was built from.
+struct CallGraph {
+public:
+    std::vector<std::string> Names;
+    // Callees of F are Targets[Start[F] .. Start[F + 1]), sorted, unique
+    std::vector<uint32_t> Start = {0};
+    std::vector<uint32_t> Targets;
+
+    // Components are numbered in the order Tarjan's algorithm completes
+    // them, a reverse topological order of the condensation: every
+    // component comes after all the components it calls into
+    std::vector<uint32_t> Component;
+    std::vector<uint32_t> ComponentSize;
+    // Condensation DAG in CSR form, without self loops
+    std::vector<uint32_t> ComponentStart = {0};
+    std::vector<uint32_t> ComponentTargets;
+
+private:
+    // Counting sort by caller, then every row is sorted on its own
+    static void BuildCsr(size_t N, std::vector<std::pair<uint32_t, uint32_t>>& Edges, std::vector<uint32_t>& Start,
+                         std::vector<uint32_t>& Targets) {
+        Start.assign(N + 1, 0);
+        for (const auto& Edge : Edges)
+            Start[Edge.first + 1]++;
+        for (size_t Row = 0; Row < N; ++Row)
+            Start[Row + 1] += Start[Row];
+
+        Targets.resize(Edges.size());
+        std::vector<uint32_t> Fill(Start.begin(), Start.end() - 1);
+        for (const auto& Edge : Edges)
+            Targets[Fill[Edge.first]++] = Edge.second;
+
+        // Drop duplicates and compact the rows in place
+        size_t Out = 0;
+        for (size_t Row = 0; Row < N; ++Row) {
+            auto Begin = Targets.begin() + Start[Row];
+            auto End = Targets.begin() + Start[Row + 1];
+            std::sort(Begin, End);
+            End = std::unique(Begin, End);
+
+            Start[Row] = Out;
+            for (auto Iter = Begin; Iter != End; ++Iter)
+                Targets[Out++] = *Iter;
+        }
+        Start[N] = Out;
+        Targets.resize(Out);
+    }
+
+    // Iterative Tarjan, recursion would overflow on long call chains
+    void Condense() {
+        size_t N = size();
+        const uint32_t Unvisited = UINT32_MAX;
+
+        std::vector<uint32_t> Order(N, Unvisited);
+        std::vector<uint32_t> Low(N, 0);
+        std::vector<char> OnStack(N, 0);
+        std::vector<uint32_t> Stack;
+        std::vector<std::pair<uint32_t, uint32_t>> Frames;
+        uint32_t Counter = 0;
+
+        Component.assign(N, 0);
+        ComponentSize.clear();
+
+        for (uint32_t Root = 0; Root < N; ++Root) {
+            if (Order[Root] != Unvisited)
+                continue;
+
+            Frames.push_back({Root, Start[Root]});
+            Order[Root] = Low[Root] = Counter++;
+            Stack.push_back(Root);
+            OnStack[Root] = 1;
+
+            while (!Frames.empty()) {
+                auto& [Func, Edge] = Frames.back();
+                if (Edge < Start[Func + 1]) {
+                    uint32_t Callee = Targets[Edge++];
+                    if (Order[Callee] == Unvisited) {
+                        Order[Callee] = Low[Callee] = Counter++;
+                        Stack.push_back(Callee);
+                        OnStack[Callee] = 1;
+                        Frames.push_back({Callee, Start[Callee]});
+                    } else if (OnStack[Callee]) {
+                        Low[Func] = std::min(Low[Func], Order[Callee]);
+                    }
+                    continue;
+                }
+
+                uint32_t Done = Func;
+                Frames.pop_back();
+                if (!Frames.empty())
+                    Low[Frames.back().first] = std::min(Low[Frames.back().first], Low[Done]);
+
+                if (Low[Done] != Order[Done])
+                    continue;
+
+                uint32_t Id = ComponentSize.size();
+                ComponentSize.push_back(0);
+                uint32_t Member;
+                do {
+                    Member = Stack.back();
+                    Stack.pop_back();
+                    OnStack[Member] = 0;
+                    Component[Member] = Id;
+                    ComponentSize[Id]++;
+                } while (Member != Done);
+            }
+        }
+
+        std::vector<std::pair<uint32_t, uint32_t>> Edges;
+        for (uint32_t Func = 0; Func < N; ++Func)
+            for (uint32_t Edge = Start[Func]; Edge < Start[Func + 1]; ++Edge)
+                if (Component[Func] != Component[Targets[Edge]])
+                    Edges.push_back({Component[Func], Component[Targets[Edge]]});
+        BuildCsr(ComponentSize.size(), Edges, ComponentStart, ComponentTargets);
+    }
+
+public:
+    CallGraph() = default;
+
+    // Calls are (caller, callee) pairs of indices into Names
+    CallGraph(std::vector<std::string> Names_, std::vector<std::pair<uint32_t, uint32_t>> Calls)
+        : Names(std::move(Names_)) {
+        BuildCsr(Names.size(), Calls, Start, Targets);
+        Condense();
+    }
+
+public:
+    size_t size() const { return Names.size(); }
+
+    size_t edgeCount() const { return Targets.size(); }
+
+    size_t componentCount() const { return ComponentSize.size(); }
+
+    // Part of a cycle of calls, direct or not
+    bool isRecursive(uint32_t Func) const {
+        if (ComponentSize[Component[Func]] > 1)
+            return true;
+        return std::binary_search(Targets.begin() + Start[Func], Targets.begin() + Start[Func + 1], Func);
+    }
+
+    // Components with callers before callees
+    std::vector<uint32_t> topologicalOrder() const {
+        std::vector<uint32_t> Order(componentCount());
+        for (size_t Id = 0; Id < Order.size(); ++Id)
+            Order[Id] = Order.size() - 1 - Id;
+        return Order;
+    }
+
+public:
+    // Functions of a non-trivial component share a cluster
+    std::string Dot() const {
+        std::ostringstream out;
+        out << "digraph CallGraph {\n";
+
+        std::vector<std::vector<uint32_t>> Members(componentCount());
+        for (uint32_t Func = 0; Func < size(); ++Func)
+            Members[Component[Func]].push_back(Func);
+
+        for (uint32_t Id = 0; Id < Members.size(); ++Id) {
+            bool Cluster = Members[Id].size() > 1;
+            if (Cluster)
+                out << "    subgraph cluster_" << Id << " {\n";
+            for (uint32_t Func : Members[Id])
+                out << (Cluster ? "        " : "    ") << 'f' << Func << " [label=\"" << Names[Func] << "\"];\n";
+            if (Cluster)
+                out << "    }\n";
+        }
+
+        for (uint32_t Func = 0; Func < size(); ++Func)
+            for (uint32_t Edge = Start[Func]; Edge < Start[Func + 1]; ++Edge)
+                out << "    f" << Func << " -> f" << Targets[Edge] << ";\n";
+
+        out << "}\n";
+        return out.str();
+    }
+
+    // Little-endian:
+    //   "CGR1", u32 functions, u32 calls, u32 components,
+    //   u32 Start[functions + 1], u32 Targets[calls], u32 Component[functions],
+    //   then every name as u32 length and bytes
+    std::string Binary() const {
+        std::string out = "CGR1";
+        auto Put = [&out](uint32_t Value) {
+            for (int Byte = 0; Byte < 4; ++Byte)
+                out.push_back(char(Value >> (8 * Byte) & 0xff));
+        };
+
+        Put(size());
+        Put(edgeCount());
+        Put(componentCount());
+        for (uint32_t Value : Start)
+            Put(Value);
+        for (uint32_t Value : Targets)
+            Put(Value);
+        for (uint32_t Value : Component)
+            Put(Value);
+        for (const auto& Name : Names) {
+            Put(Name.size());
+            out += Name;
+        }
+        return out;
+    }
+};
+
+// Calls of one or more translation units. Functions are keyed by USR, so
+// that a function defined in one unit and called from another is one node
+// once the units are merged with Add, and recursion across units is
+// condensed like any other.
+struct CallEdges {
+public:
+    std::vector<std::string> Usrs;
+    // Labels, qualified name and parameter types
+    std::vector<std::string> Names;
+    // (caller, callee) pairs of indices into Usrs
+    std::vector<std::pair<uint32_t, uint32_t>> Calls;
+
+private:
+    std::unordered_map<std::string, uint32_t> Ids;
+
+public:
+    uint32_t Id(const std::string& Usr, const std::string& Name) {
+        auto [Iter, Inserted] = Ids.try_emplace(Usr, Usrs.size());
+        if (Inserted) {
+            Usrs.push_back(Usr);
+            Names.push_back(Name);
+        }
+        return Iter->second;
+    }
+
+    // Repeated calls are dropped when the graph is built
+    void Add(const CallEdges& Unit) {
+        std::vector<uint32_t> Map(Unit.Usrs.size());
+        for (size_t Func = 0; Func < Map.size(); ++Func)
+            Map[Func] = Id(Unit.Usrs[Func], Unit.Names[Func]);
+        for (const auto& [Caller, Callee] : Unit.Calls)
+            Calls.push_back({Map[Caller], Map[Callee]});
+    }
+
+    CallGraph Build() const { return CallGraph(Names, Calls); }
+};
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "clang/AST/Decl.h"
+#include "clang/Index/USRGeneration.h"
+#include "llvm/ADT/SmallString.h"
+
+#include "call_graph.hpp"
+
+namespace cfg {
+
+// Collects call edges while the visitor walks function bodies. Functions
+// are keyed by the USR of their canonical declaration, so calls through a
+// prototype and the definition end up on the same node, here and in the
+// units the edges are later merged with.
+struct CallCollector {
+private:
+    std::unordered_map<const clang::FunctionDecl*, uint32_t> Ids;
+    CallEdges Edges_;
+    std::vector<uint32_t> Callers;
+
+private:
+    // Overloads differ in their label as well
+    static std::string Label(const clang::FunctionDecl* Func) {
+        std::string Name = Func->getQualifiedNameAsString() + "(";
+        for (unsigned Index = 0; Index < Func->getNumParams(); ++Index)
+            Name += (Index ? ", " : "") + Func->getParamDecl(Index)->getType().getAsString();
+        return Name + ")";
+    }
+
+    uint32_t Id(const clang::FunctionDecl* Func) {
+        Func = Func->getCanonicalDecl();
+        auto Found = Ids.find(Func);
+        if (Found != Ids.end())
+            return Found->second;
+
+        std::string Name = Label(Func);
+        llvm::SmallString<128> Usr;
+        uint32_t Id = Edges_.Id(clang::index::generateUSRForDecl(Func, Usr) ? Name : std::string(Usr), Name);
+        Ids.emplace(Func, Id);
+        return Id;
+    }
+
+public:
+    void Enter(const clang::FunctionDecl* Func) { Callers.push_back(Id(Func)); }
+
+    void Leave() { Callers.pop_back(); }
+
+    // Calls outside of a function body (global initializers) are not edges
+    void Record(const clang::FunctionDecl* Callee) {
+        if (!Callers.empty())
+            Edges_.Calls.push_back({Callers.back(), Id(Callee)});
+    }
+
+    const CallEdges& Edges() const { return Edges_; }
+
+    CallGraph Build() const { return Edges_.Build(); }
+};
+
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include "clang/Analysis/CFG.h"
+
+#include "ast.hpp"
+
+namespace cfg {
+
+namespace ast {
+
+// Same flow graph as Function, but derived from clang::CFG instead of the
+// hand-written statement builders. Every statement kind clang understands
+// is covered; only multi-way terminators (switch, computed goto) throw.
+struct ClangFunction : Node {
+private:
+    struct BlockFlow {
+        graphiz::FlowNode* First = nullptr;
+        graphiz::FlowNode* Last = nullptr;
+        graphiz::Condition* Cond = nullptr;
+    };
+
+private:
+    Arena& Nodes;
+    graphiz::Call* CallFlow = nullptr;
+    std::vector<graphiz::FlowNode*> Created;
+
+    std::unordered_map<const clang::CFGBlock*, BlockFlow> Blocks;
+    std::unordered_map<const clang::DeclStmt*, const clang::DeclStmt*> SourceDecls;
+
+private:
+    static const clang::Stmt* StripParens(const clang::Stmt* Stmt) {
+        if (const auto* E = llvm::dyn_cast_or_null<clang::Expr>(Stmt))
+            return E->IgnoreParens();
+        return Stmt;
+    }
+
+    // Successors in terminator order; unreachable ones are null
+    static std::vector<const clang::CFGBlock*> Succs(const clang::CFGBlock* Block) {
+        std::vector<const clang::CFGBlock*> Result;
+        for (auto Iter = Block->succ_begin(); Iter != Block->succ_end(); ++Iter)
+            Result.push_back(*Iter);
+        return Result;
+    }
+
+    static std::vector<const clang::CFGBlock*> ReachableSuccs(const clang::CFGBlock* Block) {
+        std::vector<const clang::CFGBlock*> Result;
+        for (const auto* Succ : Succs(Block))
+            if (Succ)
+                Result.push_back(Succ);
+        return Result;
+    }
+
+    template <typename T>
+    T* NewNode(const std::string& Label, const clang::Stmt* Source) {
+        T* Node = Nodes.Make<T>(Label);
+        if (Source)
+            Node->Stmts.push_back(Source);
+        Created.push_back(Node);
+        return Node;
+    }
+
+    void Append(BlockFlow& Flow, graphiz::Statement* Stmt) {
+        if (!Flow.First)
+            Flow.First = Stmt;
+        if (Flow.Last)
+            Flow.Last->assign(Stmt);
+        Flow.Last = Stmt;
+    }
+
+    void BuildBlock(const clang::CFGBlock* Block, clang::ASTContext* Context) {
+        BlockFlow Flow;
+
+        const clang::Stmt* CondStmt = StripParens(Block->getTerminatorCondition(false));
+        const clang::DeclStmt* LastSource = nullptr;
+
+        for (const clang::CFGElement& Elem : *Block) {
+            auto CfgStmt = Elem.getAs<clang::CFGStmt>();
+            if (!CfgStmt)
+                continue;
+
+            const clang::Stmt* Stmt = CfgStmt->getStmt();
+            if (CondStmt && StripParens(Stmt) == CondStmt)
+                continue;
+
+            // clang splits `int a = 0, b = 1;` into one synthetic DeclStmt per
+            // variable; the builder keeps them in a single node
+            if (const auto* DeclStmt = llvm::dyn_cast<clang::DeclStmt>(Stmt)) {
+                auto Source = SourceDecls.find(DeclStmt);
+                const clang::DeclStmt* Original = Source == SourceDecls.end() ? DeclStmt : Source->second;
+                if (Original == LastSource)
+                    continue;
+                LastSource = Original;
+
+                Append(Flow, NewNode<graphiz::Statement>(prettyDecl(Original, Context), Original));
+                continue;
+            }
+            LastSource = nullptr;
+
+            Append(Flow, NewNode<graphiz::Statement>(prettyStmt(Stmt, Context), Stmt));
+        }
+
+        if (CondStmt) {
+            Flow.Cond = NewNode<graphiz::Condition>(prettyStmt(CondStmt, Context), CondStmt);
+            if (!Flow.First)
+                Flow.First = Flow.Cond;
+            if (Flow.Last)
+                Flow.Last->assign(Flow.Cond);
+            Flow.Last = Flow.Cond;
+        }
+
+        if (Flow.First)
+            Blocks[Block] = Flow;
+    }
+
+    // Entry node of a block; empty blocks (break, continue, joins) forward to
+    // their only successor and the exit block has no node at all
+    graphiz::FlowNode* Entry(const clang::CFGBlock* Block) {
+        std::unordered_set<const clang::CFGBlock*> Seen;
+
+        while (Block) {
+            auto Flow = Blocks.find(Block);
+            if (Flow != Blocks.end())
+                return Flow->second.First;
+
+            if (!Seen.insert(Block).second) {
+                // Loop made of empty blocks only, e.g. `for (;;) {}`
+                auto* Placeholder = NewNode<graphiz::Statement>("", nullptr);
+                Blocks[Block] = {Placeholder, Placeholder, nullptr};
+                Link(Block, Placeholder, nullptr);
+                return Placeholder;
+            }
+
+            auto Targets = ReachableSuccs(Block);
+            if (Targets.size() > 1)
+                throw std::exception();
+            Block = Targets.empty() ? nullptr : Targets.front();
+        }
+
+        return nullptr;
+    }
+
+    void Link(const clang::CFGBlock* Block, graphiz::FlowNode* Last, graphiz::Condition* Cond) {
+        if (Cond) {
+            auto Branches = Succs(Block);
+            if (Branches.size() != 2)
+                throw std::exception();
+            if (graphiz::FlowNode* Then = Entry(Branches[0]))
+                Cond->assignT(Then);
+            if (graphiz::FlowNode* Else = Entry(Branches[1]))
+                Cond->assignF(Else);
+            return;
+        }
+
+        auto Targets = ReachableSuccs(Block);
+        if (Targets.size() > 1)
+            throw std::exception();
+        if (Targets.empty())
+            return;
+
+        if (graphiz::FlowNode* Next = Entry(Targets.front()))
+            Last->assign(Next);
+    }
+
+public:
+    ClangFunction(clang::FunctionDecl* FuncDecl, clang::ASTContext* Context, Arena& Nodes) : Nodes(Nodes) {
+        clang::CFG::BuildOptions Options;
+        // Keep both arms of constant conditions, as the syntactic builder does
+        Options.PruneTriviallyFalseEdges = false;
+
+        std::unique_ptr<clang::CFG> Cfg = clang::CFG::buildCFG(FuncDecl, FuncDecl->getBody(), Context, Options);
+        if (!Cfg)
+            throw std::exception();
+
+        for (const auto& Synthetic : Cfg->synthetic_stmts())
+            SourceDecls[Synthetic.first] = Synthetic.second;
+
+        for (const clang::CFGBlock* Block : *Cfg)
+            if (Block != &Cfg->getEntry() && Block != &Cfg->getExit())
+                BuildBlock(Block, Context);
+
+        // Placeholders created by Entry() are linked on creation
+        std::vector<std::pair<const clang::CFGBlock*, BlockFlow>> Built(Blocks.begin(), Blocks.end());
+        for (const auto& [Block, Flow] : Built)
+            Link(Block, Flow.Last, Flow.Cond);
+
+        CallFlow = makeCall(FuncDecl, Nodes);
+        if (graphiz::FlowNode* Start = Entry(&Cfg->getEntry()))
+            CallFlow->assign(Start);
+    }
+
+public:
+    graphiz::FlowNode* FlowStart() const override {
+        return CallFlow;
+    }
+
+    std::vector<graphiz::FlowNode*> FlowEnd() const override {
+        return {};
+    }
+
+    std::vector<graphiz::FlowNode*> FlowNodes() const override {
+        return Created;
+    }
+};
+
+}
+}
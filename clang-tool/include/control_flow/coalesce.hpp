@@ -0,0 +1,61 @@
+#pragma once
+
+#include "index.hpp"
+
+namespace cfg {
+
+namespace graphiz {
+
+struct CoalesceStats {
+    size_t NodesBefore = 0;
+    size_t EdgesBefore = 0;
+    size_t NodesAfter = 0;
+    size_t EdgesAfter = 0;
+
+    double Ratio() const {
+        if (!NodesAfter)
+            return 1;
+        return static_cast<double>(NodesBefore) / NodesAfter;
+    }
+};
+
+// Merges maximal single-entry/single-exit chains of statements into one
+// basic block node. Branches, calls and join points are left untouched,
+// so every rendered edge keeps its meaning.
+inline CoalesceStats coalesce(FlowNode* Root) {
+    CoalesceStats Stats;
+
+    Index Before(Root);
+    Stats.NodesBefore = Before.size();
+    Stats.EdgesBefore = Before.edgeCount();
+
+    std::vector<int> InDegree = Before.inDegree();
+    std::vector<bool> Absorbed(Before.size(), false);
+
+    for (size_t Id = 0; Id < Before.size(); ++Id) {
+        if (Absorbed[Id] || !Before.Nodes[Id]->isStatement())
+            continue;
+
+        auto* Block = static_cast<Statement*>(Before.Nodes[Id]);
+        while (Block->endpointT() && Block->endpointT() == Block->endpointF()) {
+            FlowNode* Next = Block->endpointT();
+            int NextId = Before.id(Next);
+
+            if (Next == Block || Next == Root || !Next->isStatement() || InDegree[NextId] != 1)
+                break;
+
+            Block->absorb(static_cast<Statement*>(Next));
+            Absorbed[NextId] = true;
+        }
+    }
+
+    Index After(Root);
+    Stats.NodesAfter = After.size();
+    Stats.EdgesAfter = After.edgeCount();
+
+    return Stats;
+}
+
+}
+
+}
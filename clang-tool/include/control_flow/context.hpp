@@ -1,25 +1,182 @@
 #pragma once
 
 #include <map>
+#include <sstream>
 
 #include "ast.hpp"
+#include "calls.hpp"
+#include "clang_cfg.hpp"
+#include "coalesce.hpp"
+#include "defuse.hpp"
+#include "dot.hpp"
+#include "fingerprint.hpp"
+#include "loops.hpp"
+#include "options.hpp"
+#include "svg.hpp"
 
 namespace cfg {
 
+inline ast::Node* CreateFunction(clang::FunctionDecl* FuncDecl, clang::ASTContext* Context, CfgBackend Backend,
+                                 Arena& Nodes) {
+    if (Backend == CfgBackend::Clang)
+        return Nodes.Make<ast::ClangFunction>(FuncDecl, Context, Nodes);
+    return Nodes.Make<ast::Function>(FuncDecl, Context, Nodes);
+}
+
 struct Context {
 public:
-    ast::Node* Top = nullptr;
+    // Owns every node of the functions below
+    Arena Nodes;
+    std::vector<ast::Node*> Functions;
+    CallCollector Calls;
 
 public:
-    void Draw(std::ofstream &ofstream) {
-        renderGraph(Top->FlowStart(), ofstream);
+    // The DOT file in pieces (header, one per function, footer), ready for
+    // a vectored write. Node names are the function's position and the
+    // node's preorder number, both independent of addresses.
+    std::vector<std::string> Render() const {
+        std::vector<std::string> Chunks = {"digraph FlowGraph {\n"};
+        for (size_t Id = 0; Id < Functions.size(); ++Id) {
+            std::ostringstream out;
+            graphiz::renderFlowNodes(graphiz::Index(Functions[Id]->FlowStart()), "f" + std::to_string(Id) + "_", out);
+            Chunks.push_back(out.str());
+        }
+        Chunks.push_back("}\n");
+        return Chunks;
+    }
+
+    // Laid out here instead of by Graphviz: header, one group per function
+    // (stacked vertically), footer
+    std::vector<std::string> RenderSvg() const {
+        std::vector<std::string> Chunks = {""};
+        double Width = 0;
+        double Height = 0;
+        for (auto* Func : Functions) {
+            graphiz::Index Nodes(Func->FlowStart());
+            graphiz::Layout Layout(Nodes);
+            Width = std::max(Width, Layout.Width);
+            Chunks.push_back(graphiz::renderSvgGraph(Layout, Nodes, Height));
+        }
+        Chunks.front() = graphiz::svgHeader(Width, Height);
+        Chunks.push_back("</svg>\n");
+        return Chunks;
+    }
+
+    struct LoopTotals {
+        size_t Loops = 0;
+        size_t Irreducible = 0;
+        int MaxDepth = 0;
+    };
+
+    // One TSV line per function: counts, depth statistics and, per node in
+    // preorder, its loop depth and innermost loop (-1 outside loops)
+    std::vector<std::string> RenderLoops(LoopTotals& Totals) const {
+        std::vector<std::string> Chunks = {
+            "function\tnodes\tloops\tirreducible\tback_edges\tmax_depth\tmean_depth\tloop_depth\tloop_of\n"};
+        for (auto* Func : Functions) {
+            graphiz::Index Nodes(Func->FlowStart());
+            graphiz::LoopForest Forest(Nodes);
+
+            Totals.Loops += Forest.Loops.size();
+            Totals.Irreducible += Forest.irreducibleCount();
+            Totals.MaxDepth = std::max(Totals.MaxDepth, Forest.maxDepth());
+
+            double DepthSum = 0;
+            for (int Depth : Forest.Depth)
+                DepthSum += Depth;
+
+            std::ostringstream out;
+            out << Nodes.Nodes[0]->getNodeLabel() << '\t' << Nodes.size() << '\t' << Forest.Loops.size() << '\t'
+                << Forest.irreducibleCount() << '\t' << Forest.BackEdges.size() << '\t' << Forest.maxDepth() << '\t'
+                << DepthSum / Nodes.size() << '\t';
+            for (size_t Id = 0; Id < Nodes.size(); ++Id)
+                out << (Id ? "," : "") << Forest.Depth[Id];
+            out << '\t';
+            for (size_t Id = 0; Id < Nodes.size(); ++Id)
+                out << (Id ? "," : "") << Forest.LoopOf[Id];
+            out << '\n';
+            Chunks.push_back(out.str());
+        }
+        return Chunks;
+    }
+
+    struct DataflowTotals {
+        size_t Variables = 0;
+        size_t Definitions = 0;
+        size_t Unreachable = 0;
+    };
+
+    // One TSV line per function with the sizes of the problems, the most
+    // and average variables live on node entry, and the solver's visits.
+    // Nodes no path from the entry reaches are reported in Warnings.
+    std::vector<std::string> RenderDataflow(DataflowTotals& Totals, std::vector<std::string>& Warnings) const {
+        std::vector<std::string> Chunks = {"function\tnodes\tvariables\tdefinitions\tunreachable\tmax_live\t"
+                                           "mean_live\tliveness_visits\treaching_visits\n"};
+        for (auto* Func : Functions) {
+            graphiz::Index Nodes(Func->FlowStart(), Func->FlowNodes());
+            DefUse Accesses(Nodes);
+
+            auto Reached = graphiz::solveDataflow(Nodes, graphiz::reachabilityProblem(Nodes));
+            auto Live = graphiz::solveDataflow(Nodes, Accesses.Liveness());
+            auto Reaching = graphiz::solveDataflow(Nodes, Accesses.ReachingDefinitions());
+
+            std::string Name = Nodes.Nodes[0]->getNodeLabel();
+            size_t Unreachable = 0;
+            size_t MaxLive = 0;
+            double LiveSum = 0;
+            for (size_t Id = 0; Id < Nodes.size(); ++Id) {
+                size_t Count = Live.In[Id].count();
+                MaxLive = std::max(MaxLive, Count);
+                LiveSum += Count;
+
+                if (Reached.Out[Id].test(0))
+                    continue;
+                ++Unreachable;
+                std::string Label = Nodes.Nodes[Id]->getNodeLabel();
+                if (!Label.empty())
+                    Warnings.push_back("unreachable code in " + Name + ": " + Label);
+            }
+
+            Totals.Variables += Accesses.Variables.size();
+            Totals.Definitions += Accesses.Definitions.size();
+            Totals.Unreachable += Unreachable;
+
+            std::ostringstream out;
+            out << Name << '\t' << Nodes.size() << '\t' << Accesses.Variables.size() << '\t'
+                << Accesses.Definitions.size() << '\t' << Unreachable << '\t' << MaxLive << '\t'
+                << LiveSum / Nodes.size() << '\t' << Live.Visits << '\t' << Reaching.Visits << '\n';
+            Chunks.push_back(out.str());
+        }
+        return Chunks;
+    }
+
+    // Structural hashes of the graphs as they are rendered
+    graphiz::FingerprintIndex Fingerprints(bool Labels) const {
+        graphiz::FingerprintIndex Index;
+        for (auto* Func : Functions) {
+            graphiz::Index Nodes(Func->FlowStart());
+            Index.Add(graphiz::fingerprint(Nodes, Labels), Nodes.size(), Nodes.Nodes[0]->getNodeLabel());
+        }
+        Index.Sort();
+        return Index;
+    }
+
+    graphiz::CoalesceStats Coalesce() {
+        graphiz::CoalesceStats Total;
+        for (auto* Func : Functions) {
+            auto Stats = graphiz::coalesce(Func->FlowStart());
+            Total.NodesBefore += Stats.NodesBefore;
+            Total.EdgesBefore += Stats.EdgesBefore;
+            Total.NodesAfter += Stats.NodesAfter;
+            Total.EdgesAfter += Stats.EdgesAfter;
+        }
+        return Total;
     }
 
 public:
-    void Push(ast::Function* Func) {
-        if (!Top)
-            Top = Func;
+    void Push(ast::Node* Func) {
+        Functions.push_back(Func);
     }
 };
 
-}
\ No newline at end of file
+}
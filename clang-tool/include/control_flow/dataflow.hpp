@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "index.hpp"
+
+namespace cfg {
+
+namespace graphiz {
+
+// Dense bit vector over 64-bit words. The kernels are plain loops over
+// the words, written so that the compiler can vectorise them.
+struct BitSet {
+public:
+    std::vector<uint64_t> Words;
+
+public:
+    BitSet() = default;
+    // Bits past the size stay clear, so count() is exact for full sets too
+    explicit BitSet(size_t Bits, bool Value = false) : Words((Bits + 63) / 64, Value ? ~uint64_t(0) : 0) {
+        if (Value && Bits % 64)
+            Words.back() = (uint64_t(1) << (Bits % 64)) - 1;
+    }
+
+public:
+    void set(size_t Bit) { Words[Bit / 64] |= uint64_t(1) << (Bit % 64); }
+    void reset(size_t Bit) { Words[Bit / 64] &= ~(uint64_t(1) << (Bit % 64)); }
+    bool test(size_t Bit) const { return Words[Bit / 64] >> (Bit % 64) & 1; }
+
+    size_t count() const {
+        size_t Count = 0;
+        for (uint64_t Word : Words)
+            Count += __builtin_popcountll(Word);
+        return Count;
+    }
+
+    bool operator==(const BitSet& Other) const { return Words == Other.Words; }
+
+    // this |= Other
+    void unite(const BitSet& Other) {
+        uint64_t* __restrict Out = Words.data();
+        const uint64_t* __restrict In = Other.Words.data();
+        for (size_t Word = 0, End = Words.size(); Word < End; ++Word)
+            Out[Word] |= In[Word];
+    }
+
+    // this &= Other
+    void intersect(const BitSet& Other) {
+        uint64_t* __restrict Out = Words.data();
+        const uint64_t* __restrict In = Other.Words.data();
+        for (size_t Word = 0, End = Words.size(); Word < End; ++Word)
+            Out[Word] &= In[Word];
+    }
+
+    // this = Gen | (In & ~Kill), returns whether anything changed
+    bool transfer(const BitSet& Gen, const BitSet& In, const BitSet& Kill) {
+        uint64_t* __restrict Out = Words.data();
+        const uint64_t* __restrict G = Gen.Words.data();
+        const uint64_t* __restrict I = In.Words.data();
+        const uint64_t* __restrict K = Kill.Words.data();
+        uint64_t Changed = 0;
+        for (size_t Word = 0, End = Words.size(); Word < End; ++Word) {
+            uint64_t Value = G[Word] | (I[Word] & ~K[Word]);
+            Changed |= Value ^ Out[Word];
+            Out[Word] = Value;
+        }
+        return Changed != 0;
+    }
+};
+
+enum class Direction { Forward, Backward };
+
+enum class Meet { Union, Intersection };
+
+// A gen/kill problem over the nodes of an Index. The boundary value holds
+// at the entry node (forward) or at nodes without successors (backward).
+struct DataflowProblem {
+    Direction Dir = Direction::Forward;
+    Meet Join = Meet::Union;
+    size_t Bits = 0;
+    std::vector<BitSet> Gen;
+    std::vector<BitSet> Kill;
+    BitSet Boundary;
+};
+
+// In and Out are at node entry and exit in execution order, whatever the
+// direction of the problem
+struct DataflowResult {
+    std::vector<BitSet> In;
+    std::vector<BitSet> Out;
+    // Transfer functions applied until the fixpoint
+    size_t Visits = 0;
+};
+
+// Reverse postorder of a DFS from the entry (true branch first); nodes the
+// entry does not reach follow, in the same order from each of them
+inline std::vector<int> reversePostOrder(const Index& Graph) {
+    size_t N = Graph.size();
+    std::vector<int> PostOrder;
+    PostOrder.reserve(N);
+    std::vector<char> Seen(N, 0);
+    std::vector<std::pair<int, int>> Stack;
+
+    for (size_t Root = 0; Root < N; ++Root) {
+        if (Seen[Root])
+            continue;
+        Seen[Root] = 1;
+        Stack.push_back({int(Root), 0});
+        while (!Stack.empty()) {
+            auto [Id, Next] = Stack.back();
+            int To = -1;
+            if (Next == 0)
+                To = Graph.SuccT[Id];
+            else if (Next == 1 && !Graph.isMerged(Id))
+                To = Graph.SuccF[Id];
+            else if (Next >= 2) {
+                PostOrder.push_back(Id);
+                Stack.pop_back();
+                continue;
+            }
+            Stack.back().second++;
+            if (To != -1 && !Seen[To]) {
+                Seen[To] = 1;
+                Stack.push_back({To, 0});
+            }
+        }
+    }
+
+    std::reverse(PostOrder.begin(), PostOrder.end());
+    return PostOrder;
+}
+
+// Worklist iteration in reverse postorder (postorder for backward
+// problems): every sweep visits only the nodes whose inputs changed, so
+// structured graphs settle in about loop-depth + 2 sweeps.
+inline DataflowResult solveDataflow(const Index& Graph, const DataflowProblem& Problem) {
+    size_t N = Graph.size();
+    bool Forward = Problem.Dir == Direction::Forward;
+
+    // Edges in the direction of the analysis
+    std::vector<std::vector<int>> Inputs(N);
+    std::vector<std::vector<int>> Outputs(N);
+    for (size_t Id = 0; Id < N; ++Id) {
+        int Succs[2] = {Graph.SuccT[Id], Graph.isMerged(Id) ? -1 : Graph.SuccF[Id]};
+        for (int Succ : Succs) {
+            if (Succ == -1)
+                continue;
+            if (Forward) {
+                Inputs[Succ].push_back(Id);
+                Outputs[Id].push_back(Succ);
+            } else {
+                Inputs[Id].push_back(Succ);
+                Outputs[Succ].push_back(Id);
+            }
+        }
+    }
+
+    std::vector<int> Order = reversePostOrder(Graph);
+    if (!Forward)
+        std::reverse(Order.begin(), Order.end());
+
+    // Before/After are relative to the analysis direction
+    bool Top = Problem.Join == Meet::Intersection;
+    std::vector<BitSet> Before(N, BitSet(Problem.Bits));
+    std::vector<BitSet> After(N, BitSet(Problem.Bits, Top));
+
+    auto IsBoundary = [&](int Id) { return Forward ? Id == 0 : Inputs[Id].empty(); };
+
+    DataflowResult Result;
+    std::vector<char> Dirty(N, 1);
+    bool Changed = true;
+    while (Changed) {
+        Changed = false;
+        for (int Id : Order) {
+            if (!Dirty[Id])
+                continue;
+            Dirty[Id] = 0;
+
+            BitSet& In = Before[Id];
+            if (IsBoundary(Id)) {
+                In = Problem.Boundary;
+            } else if (Inputs[Id].empty()) {
+                In = BitSet(Problem.Bits);
+            } else {
+                In = After[Inputs[Id].front()];
+                for (size_t Input = 1; Input < Inputs[Id].size(); ++Input) {
+                    if (Top)
+                        In.intersect(After[Inputs[Id][Input]]);
+                    else
+                        In.unite(After[Inputs[Id][Input]]);
+                }
+            }
+
+            Result.Visits++;
+            if (!After[Id].transfer(Problem.Gen[Id], In, Problem.Kill[Id]))
+                continue;
+            for (int Output : Outputs[Id])
+                Dirty[Output] = 1;
+            Changed = true;
+        }
+    }
+
+    Result.In = Forward ? std::move(Before) : std::move(After);
+    Result.Out = Forward ? std::move(After) : std::move(Before);
+    return Result;
+}
+
+// Forward, one bit set at the entry: nodes left with an empty Out are
+// never executed
+inline DataflowProblem reachabilityProblem(const Index& Graph) {
+    DataflowProblem Problem;
+    Problem.Bits = 1;
+    Problem.Gen.assign(Graph.size(), BitSet(1));
+    Problem.Kill.assign(Graph.size(), BitSet(1));
+    Problem.Boundary = BitSet(1, true);
+    return Problem;
+}
+
+}
+
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "clang/AST/Decl.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/Stmt.h"
+
+#include "dataflow.hpp"
+
+namespace cfg {
+
+// Reads and writes of local variables (parameters included) by the nodes
+// of one flow graph, taken from the statements every node was built from.
+// Anything that is not a plain assignment to a variable, such as a store
+// through a pointer or a reference argument, counts as a read only.
+struct DefUse {
+public:
+    struct Access {
+        uint32_t Var;
+        bool Def;
+    };
+
+public:
+    std::vector<const clang::VarDecl*> Variables;
+    // Per node of the Index, in evaluation order
+    std::vector<std::vector<Access>> Accesses;
+    // Definition sites as (node, variable), in node order
+    std::vector<std::pair<int, uint32_t>> Definitions;
+
+private:
+    std::unordered_map<const clang::VarDecl*, uint32_t> Ids;
+
+private:
+    static const clang::VarDecl* Local(const clang::Expr* Expr) {
+        const auto* Ref = llvm::dyn_cast<clang::DeclRefExpr>(Expr->IgnoreParenImpCasts());
+        if (!Ref)
+            return nullptr;
+        const auto* Var = llvm::dyn_cast<clang::VarDecl>(Ref->getDecl());
+        if (!Var || !Var->hasLocalStorage())
+            return nullptr;
+        return Var;
+    }
+
+    uint32_t Id(const clang::VarDecl* Var) {
+        auto [Iter, Inserted] = Ids.try_emplace(Var->getCanonicalDecl(), Variables.size());
+        if (Inserted)
+            Variables.push_back(Var);
+        return Iter->second;
+    }
+
+    void Walk(const clang::Stmt* Stmt, std::vector<Access>& Out) {
+        if (!Stmt)
+            return;
+
+        // Runs when called, not where it is written
+        if (llvm::isa<clang::LambdaExpr>(Stmt))
+            return;
+
+        if (const auto* Decl = llvm::dyn_cast<clang::DeclStmt>(Stmt)) {
+            for (const auto* Member : Decl->decls()) {
+                const auto* Var = llvm::dyn_cast<clang::VarDecl>(Member);
+                if (!Var || !Var->hasLocalStorage() || !Var->hasInit())
+                    continue;
+                Walk(Var->getInit(), Out);
+                Out.push_back({Id(Var), true});
+            }
+            return;
+        }
+
+        if (const auto* Op = llvm::dyn_cast<clang::BinaryOperator>(Stmt)) {
+            const clang::VarDecl* Var = Op->isAssignmentOp() ? Local(Op->getLHS()) : nullptr;
+            if (Var) {
+                Walk(Op->getRHS(), Out);
+                if (Op->isCompoundAssignmentOp())
+                    Out.push_back({Id(Var), false});
+                Out.push_back({Id(Var), true});
+                return;
+            }
+        }
+
+        if (const auto* Op = llvm::dyn_cast<clang::UnaryOperator>(Stmt)) {
+            const clang::VarDecl* Var = Op->isIncrementDecrementOp() ? Local(Op->getSubExpr()) : nullptr;
+            if (Var) {
+                Out.push_back({Id(Var), false});
+                Out.push_back({Id(Var), true});
+                return;
+            }
+        }
+
+        if (const auto* Ref = llvm::dyn_cast<clang::DeclRefExpr>(Stmt)) {
+            if (const clang::VarDecl* Var = Local(Ref))
+                Out.push_back({Id(Var), false});
+            return;
+        }
+
+        for (const clang::Stmt* Child : Stmt->children())
+            Walk(Child, Out);
+    }
+
+public:
+    explicit DefUse(const graphiz::Index& Graph) : Accesses(Graph.size()) {
+        for (size_t Node = 0; Node < Graph.size(); ++Node) {
+            for (const clang::Stmt* Stmt : Graph.Nodes[Node]->Stmts)
+                Walk(Stmt, Accesses[Node]);
+            for (const Access& Access : Accesses[Node])
+                if (Access.Def)
+                    Definitions.push_back({int(Node), Access.Var});
+        }
+    }
+
+public:
+    // Backward, may: a variable is live where some path reads it before
+    // writing it
+    graphiz::DataflowProblem Liveness() const {
+        graphiz::DataflowProblem Problem;
+        Problem.Dir = graphiz::Direction::Backward;
+        Problem.Bits = Variables.size();
+        Problem.Gen.assign(Accesses.size(), graphiz::BitSet(Problem.Bits));
+        Problem.Kill.assign(Accesses.size(), graphiz::BitSet(Problem.Bits));
+        Problem.Boundary = graphiz::BitSet(Problem.Bits);
+
+        for (size_t Node = 0; Node < Accesses.size(); ++Node) {
+            for (const Access& Access : Accesses[Node]) {
+                if (Access.Def)
+                    Problem.Kill[Node].set(Access.Var);
+                else if (!Problem.Kill[Node].test(Access.Var))
+                    Problem.Gen[Node].set(Access.Var);
+            }
+        }
+        return Problem;
+    }
+
+    // Forward, may: one bit per entry of Definitions
+    graphiz::DataflowProblem ReachingDefinitions() const {
+        graphiz::DataflowProblem Problem;
+        Problem.Bits = Definitions.size();
+        Problem.Gen.assign(Accesses.size(), graphiz::BitSet(Problem.Bits));
+        Problem.Kill.assign(Accesses.size(), graphiz::BitSet(Problem.Bits));
+        Problem.Boundary = graphiz::BitSet(Problem.Bits);
+
+        std::vector<std::vector<uint32_t>> DefsOf(Variables.size());
+        for (uint32_t Def = 0; Def < Definitions.size(); ++Def)
+            DefsOf[Definitions[Def].second].push_back(Def);
+
+        // Only the last definition of a variable within a node leaves it
+        std::vector<int> Last(Variables.size(), -1);
+        for (uint32_t Def = 0; Def < Definitions.size(); ++Def) {
+            auto [Node, Var] = Definitions[Def];
+            for (uint32_t Other : DefsOf[Var])
+                Problem.Kill[Node].set(Other);
+            if (Last[Var] != -1 && Definitions[Last[Var]].first == Node)
+                Problem.Gen[Node].reset(Last[Var]);
+            Problem.Gen[Node].set(Def);
+            Last[Var] = Def;
+        }
+        return Problem;
+    }
+};
+
+}
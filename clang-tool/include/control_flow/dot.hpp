@@ -0,0 +1,39 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+
+#include "index.hpp"
+
+namespace cfg {
+
+namespace graphiz {
+
+// Nodes are named by their preorder number behind Prefix rather than by
+// address, so the same input renders to the same bytes on every run
+inline void renderFlowNodes(const Index& Graph, const std::string& Prefix, std::ostream& out) {
+    for (size_t Id = 0; Id < Graph.size(); ++Id) {
+        const FlowNode* Node = Graph.Nodes[Id];
+        out << "    \"" << Prefix << Id << "\" [shape=" << Node->getNodeShape()
+            << ", label=\"" << Node->getNodeLabel() << "\"];\n";
+
+        if (Graph.isMerged(Id)) {
+            out << "    \"" << Prefix << Id << "\" -> \"" << Prefix << Graph.SuccT[Id] << "\";\n";
+            continue;
+        }
+        if (Graph.SuccT[Id] != -1)
+            out << "    \"" << Prefix << Id << "\" -> \"" << Prefix << Graph.SuccT[Id] << "\" [label=\"true\"];\n";
+        if (Graph.SuccF[Id] != -1)
+            out << "    \"" << Prefix << Id << "\" -> \"" << Prefix << Graph.SuccF[Id] << "\" [label=\"false\"];\n";
+    }
+}
+
+inline void renderGraph(FlowNode* Root, std::ostream& out) {
+    out << "digraph FlowGraph {\n";
+    renderFlowNodes(Index(Root), "n", out);
+    out << "}\n";
+}
+
+}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "index.hpp"
+
+namespace cfg {
+
+namespace graphiz {
+
+struct Divergence {
+    bool Equal = true;
+    // Preorder position of the first differing node
+    int Node = -1;
+    std::string Reason;
+};
+
+// Both indexes number nodes in the same deterministic preorder, so two flow
+// graphs are structurally equivalent exactly when the flat arrays match.
+inline Divergence compareGraphs(FlowNode* Lhs, FlowNode* Rhs, bool CompareLabels = false) {
+    Index L(Lhs);
+    Index R(Rhs);
+
+    auto Diverged = [](int Node, const std::string& Reason) {
+        return Divergence{false, Node, Reason};
+    };
+
+    if (L.size() != R.size())
+        return Diverged(-1, "node count " + std::to_string(L.size()) + " vs " + std::to_string(R.size()));
+
+    for (size_t Id = 0; Id < L.size(); ++Id) {
+        if (L.Nodes[Id]->getNodeShape() != R.Nodes[Id]->getNodeShape())
+            return Diverged(Id, "shape " + L.Nodes[Id]->getNodeShape() + " vs " + R.Nodes[Id]->getNodeShape());
+        if (L.SuccT[Id] != R.SuccT[Id] || L.SuccF[Id] != R.SuccF[Id])
+            return Diverged(Id, "successors of \"" + L.Nodes[Id]->getNodeLabel() + "\"");
+        if (CompareLabels && L.Nodes[Id]->getNodeLabel() != R.Nodes[Id]->getNodeLabel())
+            return Diverged(Id, "label \"" + L.Nodes[Id]->getNodeLabel() + "\" vs \"" + R.Nodes[Id]->getNodeLabel() + "\"");
+    }
+
+    return {};
+}
+
+}
+
+}
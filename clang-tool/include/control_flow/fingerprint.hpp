@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "index.hpp"
+
+namespace cfg {
+
+namespace graphiz {
+
+// FNV-1a, for node shapes and labels
+inline uint64_t hashString(const std::string& Text) {
+    uint64_t Hash = 0xcbf29ce484222325ull;
+    for (unsigned char Char : Text) {
+        Hash ^= Char;
+        Hash *= 0x100000001b3ull;
+    }
+    return Hash;
+}
+
+// Finaliser of MurmurHash3
+inline uint64_t mix64(uint64_t Value) {
+    Value ^= Value >> 33;
+    Value *= 0xff51afd7ed558ccdull;
+    Value ^= Value >> 33;
+    Value *= 0xc4ceb53fe1a85a63ull;
+    Value ^= Value >> 33;
+    return Value;
+}
+
+// Canonical hash of a flow graph. The Index numbers nodes in preorder from
+// the call node, so two graphs of the same shape get the same numbering
+// and the hash only has to cover the node kinds and successor arrays.
+// With Labels the statement text is covered too; the entry's label (name
+// and parameters of the function) never is, so renamed copies still match.
+inline uint64_t fingerprint(const Index& Graph, bool Labels) {
+    size_t N = Graph.size();
+    std::vector<uint64_t> Words(2 * N);
+    for (size_t Id = 0; Id < N; ++Id) {
+        uint64_t Kind = hashString(Graph.Nodes[Id]->getNodeShape());
+        if (Labels && Id)
+            Kind ^= mix64(hashString(Graph.Nodes[Id]->getNodeLabel()));
+        Words[2 * Id] = Kind;
+        Words[2 * Id + 1] = uint64_t(uint32_t(Graph.SuccT[Id] + 1)) << 32 | uint32_t(Graph.SuccF[Id] + 1);
+    }
+
+    // Four independent lanes over the flat array, the loop has no carried
+    // dependency between neighbouring words and vectorises
+    const uint64_t Multiplier = 0x9e3779b97f4a7c15ull;
+    uint64_t Lanes[4] = {N, N ^ 0x243f6a8885a308d3ull, N ^ 0x13198a2e03707344ull, N ^ 0xa4093822299f31d0ull};
+    size_t Word = 0;
+    for (; Word + 4 <= Words.size(); Word += 4)
+        for (int Lane = 0; Lane < 4; ++Lane)
+            Lanes[Lane] = (Lanes[Lane] ^ Words[Word + Lane]) * Multiplier + (Lanes[Lane] >> 29);
+    for (; Word < Words.size(); ++Word)
+        Lanes[Word % 4] = (Lanes[Word % 4] ^ Words[Word]) * Multiplier + (Lanes[Word % 4] >> 29);
+
+    uint64_t Hash = 0;
+    for (uint64_t Lane : Lanes)
+        Hash = mix64(Hash ^ Lane);
+    return Hash;
+}
+
+// Fingerprint to functions. Entries sort by fingerprint, so functions of
+// the same structure are adjacent and indices of separate runs merge with
+// `sort -m`.
+struct FingerprintIndex {
+public:
+    struct Entry {
+        uint64_t Fingerprint;
+        uint32_t Nodes;
+        std::string Function;
+
+        bool operator<(const Entry& Other) const {
+            if (Fingerprint != Other.Fingerprint)
+                return Fingerprint < Other.Fingerprint;
+            return Function < Other.Function;
+        }
+    };
+
+public:
+    std::vector<Entry> Entries;
+
+public:
+    void Add(uint64_t Fingerprint, uint32_t Nodes, std::string Function) {
+        Entries.push_back({Fingerprint, Nodes, std::move(Function)});
+    }
+
+    void Sort() { std::sort(Entries.begin(), Entries.end()); }
+
+    // Fingerprints shared by more than one function, and those functions
+    size_t Buckets(size_t& Duplicates) const {
+        size_t Shared = 0;
+        Duplicates = 0;
+        for (size_t Begin = 0, End; Begin < Entries.size(); Begin = End) {
+            for (End = Begin + 1; End < Entries.size(); ++End)
+                if (Entries[End].Fingerprint != Entries[Begin].Fingerprint)
+                    break;
+            if (End - Begin > 1) {
+                ++Shared;
+                Duplicates += End - Begin;
+            }
+        }
+        return Shared;
+    }
+
+    // One line per function: fingerprint (16 hex digits), nodes, function
+    std::string Render() const {
+        std::string out;
+        char Hex[17];
+        for (const auto& Entry : Entries) {
+            snprintf(Hex, sizeof(Hex), "%016llx", (unsigned long long)Entry.Fingerprint);
+            out += Hex;
+            out += '\t';
+            out += std::to_string(Entry.Nodes);
+            out += '\t';
+            out += Entry.Function;
+            out += '\n';
+        }
+        return out;
+    }
+};
+
+}
+
+}
@@ -3,12 +3,22 @@
 #include <unordered_set>
 #include <sstream>
 #include <fstream>
+#include <vector>
+
+namespace clang {
+class Stmt;
+}
 
 namespace cfg {
 
 namespace graphiz {
 
 struct FlowNode {
+public:
+    // Statements the node stands for, in execution order; dataflow
+    // analyses derive their gen/kill sets from them
+    std::vector<const clang::Stmt*> Stmts;
+
 protected:
     FlowNode* endpointT_ = nullptr;
     FlowNode* endpointF_ = nullptr;
@@ -33,6 +43,9 @@ public:
 public:
     virtual void assign(FlowNode* endpoint) = 0;
 
+public:
+    virtual bool isStatement() const { return false; }
+
 public:
     virtual std::string getNodeLabel() const = 0;
     virtual std::string getNodeShape() const = 0;
@@ -96,6 +109,20 @@ public:
         }
     }
 
+public:
+    bool isStatement() const override { return true; }
+
+    // Appends the following statement of a straight-line chain and takes over its exits
+    void absorb(const Statement* next) {
+        if (!sourceCode.empty() && sourceCode.back() != '\n' && !next->sourceCode.empty())
+            sourceCode += '\n';
+        sourceCode += next->sourceCode;
+        Stmts.insert(Stmts.end(), next->Stmts.begin(), next->Stmts.end());
+
+        endpointT_ = next->endpointT_;
+        endpointF_ = next->endpointF_;
+    }
+
 public:
     std::string getNodeLabel() const override { return sourceCode; }
 
@@ -128,42 +155,6 @@ public:
     std::string getNodeShape() const override { return "diamond"; }
 };
 
-void renderFlowNode(const FlowNode* Node, std::ostream& out, std::unordered_set<const FlowNode*>& visited) {
-    if (!Node || visited.count(Node)) return;
-
-    // Помечаем текущий узел как посещённый
-    visited.insert(Node);
-
-    // Получаем информацию об узле
-    out << "    \"" << Node << "\" [shape=" << Node->getNodeShape()
-        << ", label=\"" << Node->getNodeLabel() << "\"];\n";
-
-    // Обрабатываем тип узла и его связи
-    const auto* trueBranch = Node->endpointT();
-    const auto* falseBranch = Node->endpointF();
-    if (trueBranch && trueBranch == falseBranch) {
-        out << "    \"" << Node << "\" -> \"" << trueBranch << "\";\n";
-        renderFlowNode(trueBranch, out, visited);
-        return;
-    }
-    if (trueBranch) {
-        out << "    \"" << Node << "\" -> \"" << trueBranch << "\" [label=\"true\"];\n";
-        renderFlowNode(trueBranch, out, visited);
-    }
-    if (falseBranch) {
-        out << "    \"" << Node << "\" -> \"" << falseBranch << "\" [label=\"false\"];\n";
-        renderFlowNode(falseBranch, out, visited);
-    }
-}
-
-
-void renderGraph(const FlowNode* root, std::ostream& out) {
-    std::unordered_set<const FlowNode*> visited;
-    out << "digraph FlowGraph {\n";
-    renderFlowNode(root, out, visited);
-    out << "}\n";
-}
-
 }
 
 }
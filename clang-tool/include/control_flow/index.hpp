@@ -0,0 +1,102 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "graphiz.hpp"
+
+namespace cfg {
+
+namespace graphiz {
+
+// Flat view of a flow graph: nodes are numbered in preorder (true branch
+// first), the numbers the DOT output names them by.
+struct Index {
+public:
+    std::vector<FlowNode*> Nodes;
+    std::vector<int> SuccT;
+    std::vector<int> SuccF;
+    std::unordered_map<const FlowNode*, int> Ids;
+
+public:
+    // Nodes that Root does not reach (unreachable code) can be indexed as
+    // well; they are numbered after all reachable ones
+    explicit Index(FlowNode* Root, const std::vector<FlowNode*>& Others = {}) {
+        if (!Root)
+            return;
+
+        Walk(Root);
+        for (FlowNode* Other : Others)
+            Walk(Other);
+
+        SuccT.assign(Nodes.size(), -1);
+        SuccF.assign(Nodes.size(), -1);
+        for (size_t Id = 0; Id < Nodes.size(); ++Id) {
+            if (Nodes[Id]->endpointT())
+                SuccT[Id] = Ids[Nodes[Id]->endpointT()];
+            if (Nodes[Id]->endpointF())
+                SuccF[Id] = Ids[Nodes[Id]->endpointF()];
+        }
+    }
+
+private:
+    void Walk(FlowNode* Root) {
+        std::vector<FlowNode*> Stack = {Root};
+        while (!Stack.empty()) {
+            FlowNode* Node = Stack.back();
+            Stack.pop_back();
+            if (Ids.count(Node))
+                continue;
+
+            Ids[Node] = Nodes.size();
+            Nodes.push_back(Node);
+
+            if (Node->endpointF())
+                Stack.push_back(Node->endpointF());
+            if (Node->endpointT())
+                Stack.push_back(Node->endpointT());
+        }
+    }
+
+public:
+    size_t size() const { return Nodes.size(); }
+
+    int id(const FlowNode* Node) const {
+        auto It = Ids.find(Node);
+        return It == Ids.end() ? -1 : It->second;
+    }
+
+    // Edges as they are rendered: a node whose both endpoints match has one edge
+    bool isMerged(int Id) const { return SuccT[Id] != -1 && SuccT[Id] == SuccF[Id]; }
+
+    size_t edgeCount() const {
+        size_t Edges = 0;
+        for (size_t Id = 0; Id < Nodes.size(); ++Id) {
+            if (isMerged(Id)) {
+                ++Edges;
+                continue;
+            }
+            Edges += (SuccT[Id] != -1) + (SuccF[Id] != -1);
+        }
+        return Edges;
+    }
+
+    std::vector<int> inDegree() const {
+        std::vector<int> InDegree(Nodes.size(), 0);
+        for (size_t Id = 0; Id < Nodes.size(); ++Id) {
+            if (isMerged(Id)) {
+                ++InDegree[SuccT[Id]];
+                continue;
+            }
+            if (SuccT[Id] != -1)
+                ++InDegree[SuccT[Id]];
+            if (SuccF[Id] != -1)
+                ++InDegree[SuccF[Id]];
+        }
+        return InDegree;
+    }
+};
+
+}
+
+}
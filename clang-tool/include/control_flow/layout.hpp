@@ -0,0 +1,247 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "index.hpp"
+
+namespace cfg {
+
+namespace graphiz {
+
+// Layered (Sugiyama-style) layout of one flow graph in linear time. The
+// graphs are structured, so the general steps are replaced by what the
+// structure already provides:
+//  - cycle removal: DFS back edges are exactly the loop edges (inc -> cond);
+//  - layering: longest path over the remaining DAG;
+//  - ordering: preorder with the true branch first, which already puts
+//    then-branches left of else-branches, so there is no crossing
+//    minimisation;
+//  - coordinates: every node is placed under its predecessors (true
+//    successors to the left, false ones to the right), then each layer is
+//    swept once to remove overlaps.
+struct Layout {
+public:
+    enum class EdgeKind { Plain, True, False };
+
+    struct Box {
+        // Centre
+        double X = 0;
+        double Y = 0;
+        double Width = 0;
+        double Height = 0;
+    };
+
+    struct Edge {
+        int From;
+        int To;
+        EdgeKind Kind;
+        // Goes back to a loop header, drawn upwards
+        bool Back = false;
+    };
+
+    static constexpr double CharWidth = 7;
+    static constexpr double LineHeight = 16;
+    static constexpr double Padding = 10;
+    static constexpr double NodeGap = 30;
+    static constexpr double LayerGap = 40;
+    static constexpr double Margin = 20;
+
+public:
+    std::vector<std::vector<std::string>> Labels;
+    std::vector<Box> Boxes;
+    std::vector<Edge> Edges;
+    std::vector<int> Layer;
+    double Width = 0;
+    double Height = 0;
+
+private:
+    std::vector<std::vector<int>> EdgesFrom;
+
+private:
+    static std::vector<std::string> SplitLines(const std::string& Label) {
+        std::vector<std::string> Lines;
+        size_t Start = 0;
+        while (Start <= Label.size()) {
+            size_t End = Label.find('\n', Start);
+            if (End == std::string::npos)
+                End = Label.size();
+            if (End > Start || Lines.empty())
+                Lines.push_back(Label.substr(Start, End - Start));
+            Start = End + 1;
+        }
+        return Lines;
+    }
+
+    void Measure(const Index& Graph) {
+        Labels.resize(Graph.size());
+        Boxes.resize(Graph.size());
+        for (size_t Id = 0; Id < Graph.size(); ++Id) {
+            Labels[Id] = SplitLines(Graph.Nodes[Id]->getNodeLabel());
+
+            size_t Longest = 0;
+            for (const auto& Line : Labels[Id])
+                Longest = std::max(Longest, Line.size());
+
+            Box& Box = Boxes[Id];
+            Box.Width = std::max(40.0, Longest * CharWidth + 2 * Padding);
+            Box.Height = Labels[Id].size() * LineHeight + 2 * Padding;
+
+            // The text has to fit into the inscribed part of the shape
+            std::string Shape = Graph.Nodes[Id]->getNodeShape();
+            if (Shape == "diamond") {
+                Box.Width *= 1.6;
+                Box.Height *= 1.6;
+            } else if (Shape == "ellipse") {
+                Box.Width *= 1.3;
+            }
+        }
+    }
+
+    // Edges in DFS order (true first); an edge to a node still on the DFS
+    // stack closes a loop
+    void ClassifyEdges(const Index& Graph, std::vector<int>& PostOrder) {
+        std::vector<char> State(Graph.size(), 0);
+        std::vector<std::pair<int, int>> Stack;
+
+        auto Successors = [&](int Id) {
+            std::vector<std::pair<int, EdgeKind>> Result;
+            if (Graph.isMerged(Id)) {
+                Result.push_back({Graph.SuccT[Id], EdgeKind::Plain});
+                return Result;
+            }
+            if (Graph.SuccT[Id] != -1)
+                Result.push_back({Graph.SuccT[Id], EdgeKind::True});
+            if (Graph.SuccF[Id] != -1)
+                Result.push_back({Graph.SuccF[Id], EdgeKind::False});
+            return Result;
+        };
+
+        if (!Graph.size())
+            return;
+
+        Stack.push_back({0, 0});
+        State[0] = 1;
+        while (!Stack.empty()) {
+            auto& [Id, Next] = Stack.back();
+            auto Succs = Successors(Id);
+            if (Next == int(Succs.size())) {
+                State[Id] = 2;
+                PostOrder.push_back(Id);
+                Stack.pop_back();
+                continue;
+            }
+
+            auto [To, Kind] = Succs[Next++];
+            Edges.push_back({Id, To, Kind, State[To] == 1});
+            if (!State[To]) {
+                State[To] = 1;
+                Stack.push_back({To, 0});
+            }
+        }
+    }
+
+    void AssignLayers(const std::vector<int>& PostOrder, std::vector<std::vector<int>>& Forward) {
+        Layer.assign(Boxes.size(), 0);
+        for (auto Iter = PostOrder.rbegin(); Iter != PostOrder.rend(); ++Iter)
+            for (int To : Forward[*Iter])
+                Layer[To] = std::max(Layer[To], Layer[*Iter] + 1);
+    }
+
+    void AssignCoordinates(const std::vector<std::vector<int>>& Layers) {
+        std::vector<double> Sum(Boxes.size(), 0);
+        std::vector<int> Count(Boxes.size(), 0);
+
+        double Top = Margin;
+        for (const auto& Nodes : Layers) {
+            double LayerHeight = 0;
+            for (int Id : Nodes)
+                LayerHeight = std::max(LayerHeight, Boxes[Id].Height);
+
+            // Desired positions, then one sweep keeps the layer order and
+            // gaps; the whole layer is shifted back by the mean displacement
+            double Right = -1e300;
+            double Displacement = 0;
+            for (int Id : Nodes) {
+                double Want = Count[Id] ? Sum[Id] / Count[Id] : 0;
+                double X = std::max(Want, Right + NodeGap + Boxes[Id].Width / 2);
+                Boxes[Id].X = X;
+                Right = X + Boxes[Id].Width / 2;
+                Displacement += X - Want;
+            }
+            if (!Nodes.empty())
+                Displacement /= Nodes.size();
+
+            for (int Id : Nodes) {
+                Boxes[Id].X -= Displacement;
+                Boxes[Id].Y = Top + LayerHeight / 2;
+            }
+            Top += LayerHeight + LayerGap;
+
+            for (const Edge& Edge : OutEdges(Nodes)) {
+                double Offset = 0;
+                if (Edge.Kind == EdgeKind::True)
+                    Offset = -(Boxes[Edge.From].Width + NodeGap) / 2;
+                else if (Edge.Kind == EdgeKind::False)
+                    Offset = (Boxes[Edge.From].Width + NodeGap) / 2;
+                Sum[Edge.To] += Boxes[Edge.From].X + Offset;
+                Count[Edge.To]++;
+            }
+        }
+
+        double Left = 1e300;
+        double RightMost = -1e300;
+        for (const Box& Box : Boxes) {
+            Left = std::min(Left, Box.X - Box.Width / 2);
+            RightMost = std::max(RightMost, Box.X + Box.Width / 2);
+        }
+        for (Box& Box : Boxes)
+            Box.X += Margin - Left;
+
+        Width = Boxes.empty() ? 2 * Margin : RightMost - Left + 2 * Margin;
+        Height = Top - LayerGap + Margin;
+    }
+
+    std::vector<Edge> OutEdges(const std::vector<int>& Nodes) const {
+        std::vector<Edge> Result;
+        for (int Id : Nodes)
+            for (int EdgeId : EdgesFrom[Id])
+                if (!Edges[EdgeId].Back)
+                    Result.push_back(Edges[EdgeId]);
+        return Result;
+    }
+
+public:
+    explicit Layout(const Index& Graph) {
+        Measure(Graph);
+
+        std::vector<int> PostOrder;
+        ClassifyEdges(Graph, PostOrder);
+
+        EdgesFrom.resize(Graph.size());
+        std::vector<std::vector<int>> Forward(Graph.size());
+        for (size_t EdgeId = 0; EdgeId < Edges.size(); ++EdgeId) {
+            EdgesFrom[Edges[EdgeId].From].push_back(EdgeId);
+            if (!Edges[EdgeId].Back)
+                Forward[Edges[EdgeId].From].push_back(Edges[EdgeId].To);
+        }
+
+        AssignLayers(PostOrder, Forward);
+
+        // Preorder ids are the order inside a layer
+        std::vector<std::vector<int>> Layers;
+        for (size_t Id = 0; Id < Graph.size(); ++Id) {
+            if (Layer[Id] >= int(Layers.size()))
+                Layers.resize(Layer[Id] + 1);
+            Layers[Layer[Id]].push_back(Id);
+        }
+
+        AssignCoordinates(Layers);
+    }
+};
+
+}
+
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "index.hpp"
+
+namespace cfg {
+
+namespace graphiz {
+
+// Loops of a flow graph found from its edges alone, so graphs of every
+// backend are handled alike. One DFS identifies loop headers and each
+// node's innermost header (Wei, Mao, Zou, Chen: "A New Algorithm for
+// Identifying Loops in Decompilation"); irreducible loops, entered other
+// than through their header, are detected and flagged on the way.
+struct LoopForest {
+public:
+    struct Loop {
+        int Header;
+        // Enclosing loop, -1 for outermost ones
+        int Parent = -1;
+        int Depth = 1;
+        // Nodes of the loop including nested loops, header included
+        int Size = 0;
+        bool Irreducible = false;
+    };
+
+public:
+    std::vector<Loop> Loops;
+    // Innermost loop of every node, -1 outside of loops
+    std::vector<int> LoopOf;
+    // Number of loops around every node
+    std::vector<int> Depth;
+    // Edges closing a loop, (from, header)
+    std::vector<std::pair<int, int>> BackEdges;
+
+private:
+    // Innermost loop header of each node while the DFS runs
+    std::vector<int> HeaderOf;
+    // Position on the current DFS path (1-based), 0 when off the path
+    std::vector<int> PathPos;
+    std::vector<char> IsHeader;
+    std::vector<char> Irreducible;
+
+private:
+    // Weaves header H into the header chain of B, keeping the chain
+    // ordered by DFS path position (innermost first)
+    void TagHeader(int B, int H) {
+        if (B == H || H == -1)
+            return;
+
+        int Cur1 = B;
+        int Cur2 = H;
+        while (HeaderOf[Cur1] != -1) {
+            int Inner = HeaderOf[Cur1];
+            if (Inner == Cur2)
+                return;
+            if (PathPos[Inner] < PathPos[Cur2]) {
+                HeaderOf[Cur1] = Cur2;
+                Cur1 = Cur2;
+                Cur2 = Inner;
+            } else {
+                Cur1 = Inner;
+            }
+        }
+        HeaderOf[Cur1] = Cur2;
+    }
+
+    void Visited(int From, int To) {
+        // On the current path: a back edge, To heads a loop
+        if (PathPos[To] > 0) {
+            IsHeader[To] = 1;
+            BackEdges.push_back({From, To});
+            TagHeader(From, To);
+            return;
+        }
+
+        int Header = HeaderOf[To];
+        if (Header == -1)
+            return;
+        if (PathPos[Header] > 0) {
+            TagHeader(From, Header);
+            return;
+        }
+
+        // Entered through To, not through its header: re-entry
+        Irreducible[Header] = 1;
+        while (HeaderOf[Header] != -1) {
+            Header = HeaderOf[Header];
+            if (PathPos[Header] > 0) {
+                TagHeader(From, Header);
+                break;
+            }
+            Irreducible[Header] = 1;
+        }
+    }
+
+    // Iterative, flow graphs of generated code can be very deep
+    std::vector<int> Search(const Index& Graph) {
+        std::vector<int> PreOrder;
+        if (!Graph.size())
+            return PreOrder;
+
+        auto Successor = [&Graph](int Id, int Which) {
+            if (Which == 0)
+                return Graph.SuccT[Id];
+            if (Graph.isMerged(Id))
+                return -1;
+            return Graph.SuccF[Id];
+        };
+
+        std::vector<char> Traversed(Graph.size(), 0);
+        std::vector<std::pair<int, int>> Stack = {{0, 0}};
+        Traversed[0] = 1;
+        PathPos[0] = 1;
+        PreOrder.push_back(0);
+
+        while (!Stack.empty()) {
+            auto [Id, Next] = Stack.back();
+            if (Next == 2) {
+                PathPos[Id] = 0;
+                Stack.pop_back();
+                if (!Stack.empty())
+                    TagHeader(Stack.back().first, HeaderOf[Id]);
+                continue;
+            }
+
+            Stack.back().second++;
+            int To = Successor(Id, Next);
+            if (To == -1)
+                continue;
+
+            if (Traversed[To]) {
+                Visited(Id, To);
+                continue;
+            }
+
+            Traversed[To] = 1;
+            PathPos[To] = Stack.size() + 1;
+            PreOrder.push_back(To);
+            Stack.push_back({To, 0});
+        }
+
+        return PreOrder;
+    }
+
+public:
+    explicit LoopForest(const Index& Graph) {
+        size_t N = Graph.size();
+        HeaderOf.assign(N, -1);
+        PathPos.assign(N, 0);
+        IsHeader.assign(N, 0);
+        Irreducible.assign(N, 0);
+
+        std::vector<int> PreOrder = Search(Graph);
+
+        // Headers come before everything they contain in preorder, so
+        // parents are numbered before their nested loops
+        std::vector<int> LoopIdOf(N, -1);
+        for (int Id : PreOrder) {
+            if (!IsHeader[Id])
+                continue;
+            LoopIdOf[Id] = Loops.size();
+            Loop Loop{Id};
+            Loop.Irreducible = Irreducible[Id];
+            if (HeaderOf[Id] != -1) {
+                Loop.Parent = LoopIdOf[HeaderOf[Id]];
+                Loop.Depth = Loops[Loop.Parent].Depth + 1;
+            }
+            Loops.push_back(Loop);
+        }
+
+        LoopOf.assign(N, -1);
+        Depth.assign(N, 0);
+        for (size_t Id = 0; Id < N; ++Id) {
+            int Header = IsHeader[Id] ? int(Id) : HeaderOf[Id];
+            if (Header == -1)
+                continue;
+            LoopOf[Id] = LoopIdOf[Header];
+            Depth[Id] = Loops[LoopOf[Id]].Depth;
+        }
+
+        // Loops are numbered outer first, so sizes flow to the parents
+        // when walked backwards
+        for (size_t Id = 0; Id < N; ++Id)
+            if (LoopOf[Id] != -1)
+                Loops[LoopOf[Id]].Size++;
+        for (size_t Loop = Loops.size(); Loop-- > 0;)
+            if (Loops[Loop].Parent != -1)
+                Loops[Loops[Loop].Parent].Size += Loops[Loop].Size;
+    }
+
+public:
+    int maxDepth() const {
+        return Depth.empty() ? 0 : *std::max_element(Depth.begin(), Depth.end());
+    }
+
+    size_t irreducibleCount() const {
+        return std::count_if(Loops.begin(), Loops.end(), [](const Loop& Loop) { return Loop.Irreducible; });
+    }
+};
+
+}
+
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "layout.hpp"
+
+namespace cfg {
+
+namespace graphiz {
+
+inline std::string escapeXml(const std::string& Text) {
+    std::string Result;
+    Result.reserve(Text.size());
+    for (char C : Text) {
+        switch (C) {
+        case '&': Result += "&amp;"; break;
+        case '<': Result += "&lt;"; break;
+        case '>': Result += "&gt;"; break;
+        case '"': Result += "&quot;"; break;
+        default: Result += C;
+        }
+    }
+    return Result;
+}
+
+inline void renderSvgNode(const Layout::Box& Box, const std::string& Shape, const std::vector<std::string>& Lines,
+                          std::ostream& out) {
+    double Left = Box.X - Box.Width / 2;
+    double Top = Box.Y - Box.Height / 2;
+
+    if (Shape == "diamond") {
+        out << "<polygon points=\"" << Box.X << ',' << Top << ' ' << Left + Box.Width << ',' << Box.Y << ' '
+            << Box.X << ',' << Top + Box.Height << ' ' << Left << ',' << Box.Y << "\"/>\n";
+    } else if (Shape == "ellipse") {
+        out << "<ellipse cx=\"" << Box.X << "\" cy=\"" << Box.Y << "\" rx=\"" << Box.Width / 2
+            << "\" ry=\"" << Box.Height / 2 << "\"/>\n";
+    } else {
+        out << "<rect x=\"" << Left << "\" y=\"" << Top << "\" width=\"" << Box.Width
+            << "\" height=\"" << Box.Height << "\"/>\n";
+    }
+
+    // Lines are centred around the middle of the box
+    double FirstLine = Box.Y - (Lines.size() - 1) * Layout::LineHeight / 2;
+    out << "<text x=\"" << Box.X << "\" y=\"" << FirstLine << "\">";
+    for (size_t Line = 0; Line < Lines.size(); ++Line) {
+        out << "<tspan x=\"" << Box.X << "\"";
+        if (Line)
+            out << " dy=\"" << Layout::LineHeight << "\"";
+        out << ">" << escapeXml(Lines[Line]) << "</tspan>";
+    }
+    out << "</text>\n";
+}
+
+inline void renderSvgEdge(const Layout& Graph, const Layout::Edge& Edge, std::ostream& out) {
+    const Layout::Box& From = Graph.Boxes[Edge.From];
+    const Layout::Box& To = Graph.Boxes[Edge.To];
+
+    if (Edge.Back) {
+        // Loop edges leave and enter on the right and bend around the body
+        double StartX = From.X + From.Width / 2;
+        double EndX = To.X + To.Width / 2;
+        double Bend = std::max(StartX, EndX) + Layout::NodeGap + (From.Y - To.Y) / 8;
+        out << "<path class=\"back\" d=\"M" << StartX << ',' << From.Y << " C" << Bend << ',' << From.Y << ' '
+            << Bend << ',' << To.Y << ' ' << EndX << ',' << To.Y << "\"/>\n";
+    } else {
+        double StartY = From.Y + From.Height / 2;
+        double EndY = To.Y - To.Height / 2;
+        double Middle = (StartY + EndY) / 2;
+        out << "<path d=\"M" << From.X << ',' << StartY << " C" << From.X << ',' << Middle << ' '
+            << To.X << ',' << Middle << ' ' << To.X << ',' << EndY << "\"/>\n";
+    }
+
+    if (Edge.Kind != Layout::EdgeKind::Plain) {
+        double Side = Edge.Kind == Layout::EdgeKind::True ? -1 : 1;
+        out << "<text class=\"branch\" x=\"" << From.X + Side * (From.Width / 4 + 6) << "\" y=\""
+            << From.Y + From.Height / 2 + 4 << "\">" << (Edge.Kind == Layout::EdgeKind::True ? "true" : "false")
+            << "</text>\n";
+    }
+}
+
+// One <g> per function, stacked vertically; Offset is where this one starts
+// and is moved past it
+inline std::string renderSvgGraph(const Layout& Graph, const Index& Nodes, double& Offset) {
+    std::ostringstream out;
+    out << "<g transform=\"translate(0," << Offset << ")\">\n";
+
+    out << "<g class=\"edges\">\n";
+    for (const auto& Edge : Graph.Edges)
+        renderSvgEdge(Graph, Edge, out);
+    out << "</g>\n";
+
+    out << "<g class=\"nodes\">\n";
+    for (size_t Id = 0; Id < Nodes.size(); ++Id)
+        renderSvgNode(Graph.Boxes[Id], Nodes.Nodes[Id]->getNodeShape(), Graph.Labels[Id], out);
+    out << "</g>\n";
+
+    out << "</g>\n";
+    Offset += Graph.Height;
+    return out.str();
+}
+
+inline std::string svgHeader(double Width, double Height) {
+    std::ostringstream out;
+    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << Width << "\" height=\"" << Height
+        << "\" viewBox=\"0 0 " << Width << ' ' << Height << "\">\n"
+        << "<defs><marker id=\"arrow\" viewBox=\"0 0 10 10\" refX=\"10\" refY=\"5\" markerWidth=\"8\" "
+           "markerHeight=\"8\" orient=\"auto-start-reverse\"><path d=\"M0,0 L10,5 L0,10 z\"/></marker></defs>\n"
+        << "<style>"
+           "rect,polygon,ellipse{fill:white;stroke:black}"
+           ".edges path{fill:none;stroke:black;marker-end:url(#arrow)}"
+           ".edges path.back{stroke-dasharray:4 2}"
+           "text{font:12px monospace;text-anchor:middle;dominant-baseline:middle}"
+           "text.branch{font-size:10px;fill:#555}"
+           "</style>\n";
+    return out.str();
+}
+
+}
+
+}
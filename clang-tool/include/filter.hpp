@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/GlobPattern.h"
+
+#include "options.hpp"
+
+// Compiles path globs, reporting the first malformed one in Error
+inline bool CompileGlobs(const std::vector<std::string> &Globs, std::vector<llvm::GlobPattern> &Patterns,
+                         std::string &Error) {
+    for (const auto &Glob : Globs) {
+        auto Pattern = llvm::GlobPattern::create(Glob);
+        if (!Pattern) {
+            Error = Glob + ": " + llvm::toString(Pattern.takeError());
+            return false;
+        }
+        Patterns.push_back(std::move(*Pattern));
+    }
+    return true;
+}
+
+// Decides which files are analysed. The verdict only depends on the file,
+// so it is computed once per FileID.
+struct PathFilter {
+private:
+    const clang::SourceManager &SM;
+    bool MainFileOnly;
+    bool SkipSystemHeaders;
+    std::vector<llvm::GlobPattern> Include;
+    std::vector<llvm::GlobPattern> Exclude;
+
+    mutable llvm::DenseMap<clang::FileID, bool> Verdicts;
+
+private:
+    bool AcceptsFile(clang::FileID File, clang::SourceLocation Loc) const {
+        if (MainFileOnly && File != SM.getMainFileID())
+            return false;
+        if (SkipSystemHeaders && SM.isInSystemHeader(Loc))
+            return false;
+
+        llvm::StringRef Path = SM.getFilename(Loc);
+        if (!Include.empty()) {
+            bool Matched = false;
+            for (const auto &Pattern : Include)
+                Matched = Matched || Pattern.match(Path);
+            if (!Matched)
+                return false;
+        }
+        for (const auto &Pattern : Exclude)
+            if (Pattern.match(Path))
+                return false;
+
+        return true;
+    }
+
+public:
+    PathFilter(const clang::SourceManager &SM, const ToolOptions &Options)
+        : SM(SM), MainFileOnly(Options.MainFileOnly), SkipSystemHeaders(Options.SkipSystemHeaders) {
+        // Malformed globs are rejected when the command line is parsed
+        std::string Error;
+        CompileGlobs(Options.IncludeGlobs, Include, Error);
+        CompileGlobs(Options.ExcludeGlobs, Exclude, Error);
+    }
+
+public:
+    bool Accepts(clang::SourceLocation Loc) const {
+        // Builtins and other implicit declarations live in no file
+        if (Loc.isInvalid())
+            return false;
+
+        Loc = SM.getExpansionLoc(Loc);
+        clang::FileID File = SM.getFileID(Loc);
+
+        auto Verdict = Verdicts.find(File);
+        if (Verdict != Verdicts.end())
+            return Verdict->second;
+
+        bool Accepted = AcceptsFile(File, Loc);
+        Verdicts[File] = Accepted;
+        return Accepted;
+    }
+};
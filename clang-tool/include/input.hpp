@@ -0,0 +1,192 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "options.hpp"
+
+#include "clang/Basic/FileManager.h"
+#include "clang/Basic/Version.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Lex/HeaderSearchOptions.h"
+#include "clang/Serialization/PCHContainerOperations.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/VirtualFileSystem.h"
+
+// Runs the action on a buffer that is served to the frontend as Path from
+// an in-memory layer over the real file system, so includes, paths and
+// line numbers stay those of the disk. The buffer is not copied and must be
+// null-terminated, as mapped files and getMemBufferCopy buffers are.
+inline bool runToolOnBuffer(std::unique_ptr<clang::FrontendAction> Action, llvm::StringRef Path,
+                            llvm::MemoryBufferRef Buffer, std::string &Error,
+                            const std::vector<std::string> &ExtraArgs = {}, llvm::StringRef WorkingDirectory = {}) {
+    llvm::SmallString<256> AbsolutePath(Path);
+    if (!WorkingDirectory.empty()) {
+        llvm::sys::fs::make_absolute(WorkingDirectory, AbsolutePath);
+    } else if (std::error_code EC = llvm::sys::fs::make_absolute(AbsolutePath)) {
+        Error = EC.message();
+        return false;
+    }
+
+    auto InMemory = llvm::makeIntrusiveRefCnt<llvm::vfs::InMemoryFileSystem>();
+    // Non-owning view: the caller keeps the buffer alive until the tool is done
+    InMemory->addFile(AbsolutePath, 0, llvm::MemoryBuffer::getMemBuffer(Buffer));
+
+    // A file system of its own, so the working directory of one compile
+    // command does not leak into analyses running on other threads
+    llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> Real = llvm::vfs::createPhysicalFileSystem();
+    if (!WorkingDirectory.empty())
+        Real->setCurrentWorkingDirectory(WorkingDirectory);
+
+    auto Overlay = llvm::makeIntrusiveRefCnt<llvm::vfs::OverlayFileSystem>(Real);
+    Overlay->pushOverlay(InMemory);
+
+    auto Files = llvm::makeIntrusiveRefCnt<clang::FileManager>(clang::FileSystemOptions(), Overlay);
+
+    std::vector<std::string> Args = {"clang-tool", "-fsyntax-only"};
+    Args.insert(Args.end(), ExtraArgs.begin(), ExtraArgs.end());
+    Args.push_back(std::string(AbsolutePath));
+
+    clang::tooling::ToolInvocation Invocation(Args, std::move(Action), Files.get());
+    if (!Invocation.run()) {
+        Error = "frontend failed";
+        return false;
+    }
+    return true;
+}
+
+// Runs the action on a source file without copying it: the file is mapped
+// once and handed to runToolOnBuffer.
+inline bool runToolOnFile(std::unique_ptr<clang::FrontendAction> Action, llvm::StringRef Path, std::string &Error,
+                          const std::vector<std::string> &ExtraArgs = {}, llvm::StringRef WorkingDirectory = {}) {
+    llvm::SmallString<256> AbsolutePath(Path);
+    if (!WorkingDirectory.empty()) {
+        llvm::sys::fs::make_absolute(WorkingDirectory, AbsolutePath);
+    } else if (std::error_code EC = llvm::sys::fs::make_absolute(AbsolutePath)) {
+        Error = EC.message();
+        return false;
+    }
+
+    // mmap-ed when the file is large enough, read otherwise
+    auto Mapped = llvm::MemoryBuffer::getFile(AbsolutePath);
+    if (!Mapped) {
+        Error = Mapped.getError().message();
+        return false;
+    }
+
+    return runToolOnBuffer(std::move(Action), AbsolutePath, (*Mapped)->getMemBufferRef(), Error, ExtraArgs,
+                           WorkingDirectory);
+}
+
+// Arguments of File's compile command, minus the compiler, the file itself,
+// the output and dependency files; Directory is where the command runs
+inline std::vector<std::string> CompileArgs(const clang::tooling::CompilationDatabase &Database, llvm::StringRef File,
+                                            std::string &Directory) {
+    std::vector<clang::tooling::CompileCommand> Commands = Database.getCompileCommands(File);
+    if (Commands.empty())
+        return {};
+
+    const clang::tooling::CompileCommand &Command = Commands.front();
+    Directory = Command.Directory;
+
+    auto Adjust = clang::tooling::combineAdjusters(clang::tooling::getClangStripOutputAdjuster(),
+                                                   clang::tooling::getClangStripDependencyFileAdjuster());
+    std::vector<std::string> Args = Adjust(Command.CommandLine, Command.Filename);
+
+    std::vector<std::string> Result;
+    for (size_t Index = 1; Index < Args.size(); ++Index)
+        if (Args[Index] != Command.Filename && Args[Index] != "-c")
+            Result.push_back(Args[Index]);
+    return Result;
+}
+
+// Output paths of one input in a batch: the input's path goes into every
+// file name, graph.dot for src/a_b.cc becomes graph.src_-a__b.cc.dot. The
+// escaping ('_' to "__", '/' to "_-") keeps different inputs apart.
+inline ToolOptions ForInput(ToolOptions Options, const std::string &Input) {
+    std::string Tag;
+    for (char Char : Input) {
+        if (Char == '_')
+            Tag += "__";
+        else if (Char == '/')
+            Tag += "_-";
+        else
+            Tag += Char;
+    }
+
+    auto Rename = [&Tag](std::string &Path) {
+        if (Path.empty())
+            return;
+        size_t Name = Path.find_last_of('/') + 1;
+        size_t Dot = Path.find('.', Name);
+        Path.insert(Dot == std::string::npos ? Path.size() : Dot, "." + Tag);
+    };
+    Rename(Options.Output);
+    Rename(Options.CallGraphOutput);
+    Rename(Options.LoopsOutput);
+    Rename(Options.DataflowOutput);
+    Rename(Options.FingerprintOutput);
+    Rename(Options.MetricsOutput);
+    Rename(Options.ReportOutput);
+    return Options;
+}
+
+// Serialized ASTs: clang -emit-ast output and precompiled headers
+inline bool IsSerializedAST(llvm::StringRef Path) {
+    llvm::StringRef Extension = llvm::sys::path::extension(Path);
+    return Extension == ".ast" || Extension == ".pch";
+}
+
+// Runs a consumer from consumer.hpp over a serialized AST instead of
+// parsing: no lexing, parsing or Sema. Declarations are read from the file
+// as the traversal reaches them, and those PathFilter rejects are never
+// descended into, so bodies outside the analysed files stay on disk. The
+// file always has bodies; the class analysis ignores them as when parsing
+// unless SkipFunctionBodies is off, so the factors are those of the source.
+// The file must come from a compatible clang; its compile options are
+// those it was built with.
+template <typename Consumer>
+inline bool runConsumerOnAST(llvm::StringRef Path, const ToolOptions &Options, std::string &Error,
+                             llvm::StringRef WorkingDirectory = {}) {
+    llvm::SmallString<256> AbsolutePath(Path);
+    if (!WorkingDirectory.empty()) {
+        llvm::sys::fs::make_absolute(WorkingDirectory, AbsolutePath);
+    } else if (std::error_code EC = llvm::sys::fs::make_absolute(AbsolutePath)) {
+        Error = EC.message();
+        return false;
+    }
+
+    auto Containers = std::make_shared<clang::PCHContainerOperations>();
+    llvm::IntrusiveRefCntPtr<clang::DiagnosticsEngine> Diags =
+        clang::CompilerInstance::createDiagnostics(new clang::DiagnosticOptions());
+    std::unique_ptr<clang::ASTUnit> Unit = clang::ASTUnit::LoadFromASTFile(
+        std::string(AbsolutePath), Containers->getRawReader(), clang::ASTUnit::LoadEverything, Diags,
+        clang::FileSystemOptions()
+#if CLANG_VERSION_MAJOR >= 18
+        , std::make_shared<clang::HeaderSearchOptions>()
+#endif
+    );
+    if (!Unit) {
+        Error = "cannot load the AST file";
+        return false;
+    }
+
+    // Bodies are deserialized on first access, and the reader is not
+    // thread-safe: the graphs are built during the traversal, not as subtasks
+    ToolOptions Serial = Options;
+    Serial.SplitFunctions = 0;
+
+    clang::ASTContext &Context = Unit->getASTContext();
+    Consumer Consumer(&Context, Serial);
+    Consumer.HandleTranslationUnit(Context);
+    return true;
+}
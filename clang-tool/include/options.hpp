@@ -0,0 +1,108 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+class OutputWriter;
+class TaskPool;
+
+namespace abreu {
+struct ClassSummary;
+}
+
+namespace cfg {
+struct CallEdges;
+}
+
+enum class CfgBackend {
+    // Hand-written builders from control_flow/ast.hpp
+    Builder,
+    // clang::CFG::buildCFG
+    Clang
+};
+
+enum class OutputFormat {
+    // Graphviz input, laid out by dot
+    Dot,
+    // Laid out by clang-cfg itself (control_flow/layout.hpp)
+    Svg
+};
+
+enum class CallGraphFormat {
+    Dot,
+    // See CallGraph::Binary
+    Binary
+};
+
+enum class TemplatePolicy {
+    // Templates are counted once as written; instantiations are skipped
+    Primary,
+    // Every instantiation is counted, analysed once per pattern
+    Instantiations
+};
+
+enum class Compression {
+    None,
+    // gzip members, via LLVM's zlib support
+    Zlib,
+    // zstd frames, when LLVM is built with zstd
+    Zstd
+};
+
+struct ToolOptions {
+    // clang-cfg: merge straight-line statements into basic blocks before rendering
+    bool Coalesce = false;
+    CfgBackend Backend = CfgBackend::Builder;
+    OutputFormat Format = OutputFormat::Dot;
+    std::string Output = "graph.dot";
+    // clang-cfg: the call graph is written only when a path is given
+    std::string CallGraphOutput;
+    CallGraphFormat CallGraph = CallGraphFormat::Dot;
+    // When set, the unit's calls are stored here and no graph is written;
+    // the caller merges the units into one graph (CallEdges::Add)
+    cfg::CallEdges *Calls = nullptr;
+    // clang-cfg: loop nesting summary, per-function statistics on request.
+    // Off by default, the summary line would change the default output
+    bool Loops = false;
+    std::string LoopsOutput;
+    // clang-cfg: liveness, reaching definitions and unreachable code
+    bool Dataflow = false;
+    std::string DataflowOutput;
+    // clang-cfg: structural hash index, label text hashed unless disabled
+    std::string FingerprintOutput;
+    bool FingerprintLabels = true;
+    // clang-cfg: with a pool, a translation unit of more than SplitFunctions
+    // bodies builds their graphs as subtasks (builder backend only)
+    TaskPool *Pool = nullptr;
+    unsigned SplitFunctions = 0;
+    // Asynchronous writer stage, outputs are written synchronously without one
+    OutputWriter *Writer = nullptr;
+    // clang-cfg: MOOD factors from the same parse (UnifiedAction); classes
+    // are not analysed at all without it
+    bool Metrics = false;
+    // clang-abreu: metrics go to stdout when empty
+    std::string MetricsOutput;
+    // clang-abreu: top contributors and histograms, written when a path is given
+    std::string ReportOutput;
+    unsigned TopK = 10;
+    // clang-abreu: when set, every class is summarised here and nothing is
+    // printed; the caller combines translation units (abreu::Project)
+    std::vector<abreu::ClassSummary> *Summaries = nullptr;
+    // Outputs are compressed in blocks on CompressThreads threads (0: all)
+    Compression Compress = Compression::None;
+    unsigned CompressThreads = 0;
+
+    // Which declarations are analysed, see PathFilter
+    bool MainFileOnly = false;
+    bool SkipSystemHeaders = true;
+    std::vector<std::string> IncludeGlobs;
+    std::vector<std::string> ExcludeGlobs;
+    bool DumpAST = false;
+
+    // MOOD factors ignore method bodies, CF counts only the classes of
+    // fields and signatures; clang-abreu then does not parse them either.
+    // The same on every path, parsed, loaded from .ast or through the library
+    bool SkipFunctionBodies = true;
+    bool DelayedTemplateParsing = false;
+    TemplatePolicy Templates = TemplatePolicy::Primary;
+};
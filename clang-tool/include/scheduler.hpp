@@ -0,0 +1,315 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool for batch runs. Every worker owns a deque: it runs
+// its own tasks from the front and, once out of work, steals from the back
+// of the others'. Tasks submitted with a predicted cost go to the least
+// loaded worker, so submitting them longest-first spreads them the way
+// LPT scheduling does; stealing evens out what the predictions got wrong.
+class TaskPool {
+public:
+    // Tasks spawned together, waited for as a whole. Pending drops to 0
+    // under Mutex, so a waiter that saw it there can destroy the group.
+    struct Group {
+        std::atomic<size_t> Pending{0};
+        std::mutex Mutex;
+        std::condition_variable Done;
+    };
+
+private:
+    struct Task {
+        std::function<void()> Run;
+        double Cost = 0;
+        Group *Owner = nullptr;
+        size_t Home = 0;
+    };
+
+    struct Worker {
+        std::mutex Mutex;
+        std::deque<Task> Tasks;
+        double Load = 0;
+    };
+
+private:
+    std::vector<std::unique_ptr<Worker>> Workers;
+    std::vector<std::thread> Threads;
+
+    std::mutex Mutex;
+    std::condition_variable Wake;
+    std::condition_variable Idle;
+    std::atomic<size_t> Queued{0};
+    std::atomic<size_t> Outstanding{0};
+    bool Stopping = false;
+
+    inline static thread_local TaskPool *CurrentPool = nullptr;
+    inline static thread_local size_t CurrentWorker = 0;
+
+private:
+    size_t Self() const { return CurrentPool == this ? CurrentWorker : Workers.size(); }
+
+    size_t LeastLoaded() {
+        size_t Best = 0;
+        double BestLoad = 0;
+        for (size_t Index = 0; Index < Workers.size(); ++Index) {
+            std::lock_guard<std::mutex> Lock(Workers[Index]->Mutex);
+            if (Index == 0 || Workers[Index]->Load < BestLoad) {
+                Best = Index;
+                BestLoad = Workers[Index]->Load;
+            }
+        }
+        return Best;
+    }
+
+    void Push(size_t Index, Task Task, bool Front) {
+        Task.Home = Index;
+        {
+            std::lock_guard<std::mutex> Lock(Workers[Index]->Mutex);
+            Workers[Index]->Load += Task.Cost;
+            if (Front)
+                Workers[Index]->Tasks.push_front(std::move(Task));
+            else
+                Workers[Index]->Tasks.push_back(std::move(Task));
+        }
+        Queued++;
+        {
+            std::lock_guard<std::mutex> Lock(Mutex);
+        }
+        Wake.notify_one();
+    }
+
+    // Own deque first, then the others starting from the next worker.
+    // With Only, just the tasks of that group are taken.
+    bool TryRun(size_t Index, const Group *Only = nullptr) {
+        auto Matches = [Only](const Task &Task) { return !Only || Task.Owner == Only; };
+
+        Task Next;
+        bool Found = false;
+        for (size_t Step = 0; Step < Workers.size() && !Found; ++Step) {
+            bool Own = Step == 0 && Index < Workers.size();
+            Worker &Victim = *Workers[(Index + Step) % Workers.size()];
+            std::lock_guard<std::mutex> Lock(Victim.Mutex);
+            auto &Tasks = Victim.Tasks;
+            if (Own) {
+                auto Iter = std::find_if(Tasks.begin(), Tasks.end(), Matches);
+                if (Iter == Tasks.end())
+                    continue;
+                Next = std::move(*Iter);
+                Tasks.erase(Iter);
+            } else {
+                auto Iter = std::find_if(Tasks.rbegin(), Tasks.rend(), Matches);
+                if (Iter == Tasks.rend())
+                    continue;
+                Next = std::move(*Iter);
+                Tasks.erase(std::next(Iter).base());
+            }
+            Found = true;
+        }
+        if (!Found)
+            return false;
+        Queued--;
+
+        Next.Run();
+
+        {
+            std::lock_guard<std::mutex> Lock(Workers[Next.Home]->Mutex);
+            Workers[Next.Home]->Load -= Next.Cost;
+        }
+        if (Next.Owner) {
+            std::lock_guard<std::mutex> Lock(Next.Owner->Mutex);
+            if (--Next.Owner->Pending == 0)
+                Next.Owner->Done.notify_all();
+        }
+        if (--Outstanding == 0) {
+            std::lock_guard<std::mutex> Lock(Mutex);
+            Idle.notify_all();
+        }
+        return true;
+    }
+
+    void Loop(size_t Index) {
+        CurrentPool = this;
+        CurrentWorker = Index;
+        while (true) {
+            if (TryRun(Index))
+                continue;
+            std::unique_lock<std::mutex> Lock(Mutex);
+            Wake.wait(Lock, [this] { return Queued > 0 || Stopping; });
+            if (Stopping && Queued == 0)
+                return;
+        }
+    }
+
+public:
+    // 0 threads: one per core
+    explicit TaskPool(unsigned Threads_ = 0) {
+        if (!Threads_)
+            Threads_ = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned Index = 0; Index < Threads_; ++Index)
+            Workers.push_back(std::make_unique<Worker>());
+        for (unsigned Index = 0; Index < Threads_; ++Index)
+            Threads.emplace_back(&TaskPool::Loop, this, Index);
+    }
+
+    ~TaskPool() {
+        WaitAll();
+        {
+            std::lock_guard<std::mutex> Lock(Mutex);
+            Stopping = true;
+        }
+        Wake.notify_all();
+        for (auto &Thread : Threads)
+            Thread.join();
+    }
+
+public:
+    size_t size() const { return Workers.size(); }
+
+    void Submit(std::function<void()> Run, double Cost = 0) {
+        Outstanding++;
+        Push(LeastLoaded(), {std::move(Run), Cost}, false);
+    }
+
+    // Subtasks go to the front of the calling worker's deque: it runs them
+    // next while idle workers steal them from the back
+    void Spawn(std::function<void()> Run, Group &Group) {
+        Group.Pending++;
+        Outstanding++;
+        Task Task{std::move(Run), 0, &Group};
+        size_t Index = Self();
+        if (Index < Workers.size())
+            Push(Index, std::move(Task), true);
+        else
+            Push(LeastLoaded(), std::move(Task), false);
+    }
+
+    // Runs the group's own tasks, then blocks until those stolen by other
+    // workers are done. Other tasks are left alone: a whole unit started
+    // here would keep the waiting unit's AST alive and delay it until the
+    // nested one is done.
+    void Wait(Group &Group) {
+        while (Group.Pending > 0)
+            if (!TryRun(Self(), &Group))
+                break;
+        std::unique_lock<std::mutex> Lock(Group.Mutex);
+        Group.Done.wait(Lock, [&Group] { return Group.Pending == 0; });
+    }
+
+    void WaitAll() {
+        std::unique_lock<std::mutex> Lock(Mutex);
+        Idle.wait(Lock, [this] { return Outstanding == 0; });
+    }
+};
+
+// Predicts the cost of a translation unit in seconds. Timings of previous
+// runs are the best predictor and are used as they are, scaled by how much
+// the file grew; new files are estimated from their size and include count
+// with a rate fitted on the recorded ones.
+struct CostModel {
+public:
+    struct Entry {
+        uint64_t Bytes = 0;
+        unsigned Includes = 0;
+        double Seconds = 0;
+    };
+
+    // An include stands for about this many bytes of source to parse
+    static constexpr double BytesPerInclude = 16384;
+
+private:
+    std::map<std::string, Entry> History;
+    std::mutex Mutex;
+
+private:
+    static double Weight(uint64_t Bytes, unsigned Includes) { return Bytes + BytesPerInclude * Includes; }
+
+    double SecondsPerUnit() const {
+        double Seconds = 0;
+        double Units = 0;
+        for (const auto &[Path, Entry] : History) {
+            Seconds += Entry.Seconds;
+            Units += Weight(Entry.Bytes, Entry.Includes);
+        }
+        // Without history only the order of the predictions matters
+        return Units > 0 ? Seconds / Units : 1e-6;
+    }
+
+public:
+    // Lines of "path, bytes, includes, seconds" separated by tabs
+    bool Load(const std::string &Path) {
+        std::ifstream in(Path);
+        if (!in)
+            return false;
+        std::string Line;
+        while (std::getline(in, Line)) {
+            std::istringstream Fields(Line);
+            std::string File;
+            Entry Entry;
+            if (std::getline(Fields, File, '\t') && Fields >> Entry.Bytes >> Entry.Includes >> Entry.Seconds)
+                History[File] = Entry;
+        }
+        return true;
+    }
+
+    // Replaces the file at once, a concurrent reader sees the old or the new history
+    bool Save(const std::string &Path) {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        std::string Temporary = Path + ".tmp";
+        {
+            std::ofstream out(Temporary);
+            for (const auto &[File, Entry] : History)
+                out << File << '\t' << Entry.Bytes << '\t' << Entry.Includes << '\t' << Entry.Seconds << '\n';
+            if (!out)
+                return false;
+        }
+        return std::rename(Temporary.c_str(), Path.c_str()) == 0;
+    }
+
+    double Predict(const std::string &Path, uint64_t Bytes, unsigned Includes) {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        auto Found = History.find(Path);
+        if (Found != History.end() && Found->second.Bytes)
+            return Found->second.Seconds * Bytes / Found->second.Bytes;
+        return SecondsPerUnit() * Weight(Bytes, Includes);
+    }
+
+    void Record(const std::string &Path, uint64_t Bytes, unsigned Includes, double Seconds) {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        History[Path] = {Bytes, Includes, Seconds};
+    }
+};
+
+// #include directives of a source text, counted without preprocessing
+inline unsigned CountIncludes(const char *Begin, const char *End) {
+    unsigned Count = 0;
+    const char *Line = Begin;
+    while (Line < End) {
+        const char *Next = std::find(Line, End, '\n');
+        const char *Char = Line;
+        while (Char < Next && (*Char == ' ' || *Char == '\t'))
+            ++Char;
+        if (Char < Next && *Char == '#') {
+            ++Char;
+            while (Char < Next && (*Char == ' ' || *Char == '\t'))
+                ++Char;
+            if (Next - Char >= 7 && std::equal(Char, Char + 7, "include"))
+                ++Count;
+        }
+        Line = Next + 1;
+    }
+    return Count;
+}
@@ -0,0 +1,341 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+// Sharded runs over several processes, on one machine or on several
+// sharing a file system. Everything goes through a spool directory:
+//
+//   manifest            number of shards
+//   shard-<i>.inputs    files of shard i, one per line
+//   shard-<i>.key       options, sizes and mtimes the result was made for
+//   shard-<i>.lock      held by whoever runs shard i
+//   shard-<i>.result    what shard i produced, renamed into place whole
+//
+// A process that crashes takes only its shard with it: there is no result,
+// and the shard is run again.
+namespace shard {
+
+inline std::string ShardPath(const std::string &Spool, size_t Shard, const char *Suffix) {
+    return Spool + "/shard-" + std::to_string(Shard) + Suffix;
+}
+
+inline std::string InputsPath(const std::string &Spool, size_t Shard) { return ShardPath(Spool, Shard, ".inputs"); }
+inline std::string KeyPath(const std::string &Spool, size_t Shard) { return ShardPath(Spool, Shard, ".key"); }
+inline std::string LockPath(const std::string &Spool, size_t Shard) { return ShardPath(Spool, Shard, ".lock"); }
+inline std::string ResultPath(const std::string &Spool, size_t Shard) { return ShardPath(Spool, Shard, ".result"); }
+
+inline bool Exists(const std::string &Path) { return ::access(Path.c_str(), F_OK) == 0; }
+
+// Size and modification time of a file, "-" when it is missing
+inline std::string FileKey(const std::string &Path) {
+    struct stat Status;
+    if (::stat(Path.c_str(), &Status) != 0)
+        return "-";
+    return std::to_string(Status.st_size) + "\t" + std::to_string(Status.st_mtim.tv_sec) + "." +
+           std::to_string(Status.st_mtim.tv_nsec);
+}
+
+inline bool ReadFile(const std::string &Path, std::string &Text) {
+    std::ifstream in(Path, std::ios::binary);
+    if (!in)
+        return false;
+    Text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// Written next to Path and renamed over it, readers never see half a file
+inline bool Publish(const std::string &Path, const std::string &Text) {
+    std::string Temporary = Path + ".tmp." + std::to_string(::getpid());
+    {
+        std::ofstream out(Temporary, std::ios::binary);
+        out << Text;
+        if (!out)
+            return false;
+    }
+    return std::rename(Temporary.c_str(), Path.c_str()) == 0;
+}
+
+inline std::string Host() {
+    char Name[256] = {};
+    ::gethostname(Name, sizeof(Name) - 1);
+    return Name;
+}
+
+// O_EXCL creation is atomic on local and NFS v3+ file systems alike. The
+// lock names its owner, "<host> <pid>", see Stale
+inline bool Claim(const std::string &Spool, size_t Shard) {
+    int Descriptor = ::open(LockPath(Spool, Shard).c_str(), O_CREAT | O_EXCL | O_WRONLY, 0644);
+    if (Descriptor < 0)
+        return false;
+    std::string Owner = Host() + " " + std::to_string(::getpid()) + "\n";
+    ssize_t Written = ::write(Descriptor, Owner.data(), Owner.size());
+    (void)Written;
+    ::close(Descriptor);
+    return true;
+}
+
+inline void Release(const std::string &Spool, size_t Shard) { ::unlink(LockPath(Spool, Shard).c_str()); }
+
+// A lock whose owner is known to be gone: a process of this host that no
+// longer exists. Owners on other hosts cannot be checked and count as live.
+inline bool Stale(const std::string &Spool, size_t Shard, std::string &Owner) {
+    if (!ReadFile(LockPath(Spool, Shard), Owner))
+        return true;
+    while (!Owner.empty() && Owner.back() == '\n')
+        Owner.pop_back();
+
+    std::istringstream in(Owner);
+    std::string OwnerHost;
+    pid_t Pid = 0;
+    if (!(in >> OwnerHost >> Pid) || OwnerHost != Host() || Pid <= 0)
+        return false;
+    return ::kill(Pid, 0) != 0 && errno == ESRCH;
+}
+
+inline size_t ShardCount(const std::string &Spool) {
+    std::ifstream in(Spool + "/manifest");
+    size_t Count = 0;
+    in >> Count;
+    return Count;
+}
+
+inline std::vector<std::string> Inputs(const std::string &Spool, size_t Shard) {
+    std::ifstream in(InputsPath(Spool, Shard));
+    std::vector<std::string> Result;
+    std::string Line;
+    while (std::getline(in, Line))
+        if (!Line.empty())
+            Result.push_back(Line);
+    return Result;
+}
+
+// Splits the inputs into shards of about the same cost, largest first onto
+// the cheapest shard. Shards keep the inputs in their original order.
+inline std::vector<std::vector<std::string>> Split(const std::vector<std::string> &Inputs,
+                                                   const std::vector<double> &Costs, size_t Shards) {
+    Shards = std::max<size_t>(1, std::min(Shards, Inputs.size()));
+    std::vector<size_t> Order(Inputs.size());
+    for (size_t Index = 0; Index < Order.size(); ++Index)
+        Order[Index] = Index;
+    std::stable_sort(Order.begin(), Order.end(), [&Costs](size_t Left, size_t Right) {
+        return Costs[Left] > Costs[Right];
+    });
+
+    std::vector<double> Load(Shards);
+    std::vector<std::vector<size_t>> Members(Shards);
+    for (size_t Index : Order) {
+        size_t Cheapest = std::min_element(Load.begin(), Load.end()) - Load.begin();
+        Load[Cheapest] += Costs[Index];
+        Members[Cheapest].push_back(Index);
+    }
+
+    std::vector<std::vector<std::string>> Result(Shards);
+    for (size_t Shard = 0; Shard < Shards; ++Shard) {
+        std::sort(Members[Shard].begin(), Members[Shard].end());
+        for (size_t Index : Members[Shard])
+            Result[Shard].push_back(Inputs[Index]);
+    }
+    return Result;
+}
+
+// Lays the shards out in the spool. Results of a previous run are dropped,
+// unless Resume is set and the shard's key is unchanged: the same Options
+// (everything else that shapes a result) and inputs of the same size and
+// modification time. Headers are not part of the key, a run after editing
+// only headers must not resume. Stale locks, left by a coordinator that was
+// killed, are removed; a spool with live ones (or ones on other hosts) is
+// refused unless Force is set.
+inline bool Prepare(const std::string &Spool, const std::vector<std::vector<std::string>> &Shards,
+                    const std::string &Options, bool Resume, bool Force, std::string &Error) {
+    if (::mkdir(Spool.c_str(), 0755) != 0 && errno != EEXIST) {
+        Error = Spool + ": " + std::strerror(errno);
+        return false;
+    }
+
+    // Checked before anything changes, a refused spool is left as it was
+    size_t Previous = ShardCount(Spool);
+    size_t Count = std::max(Previous, Shards.size());
+    for (size_t Shard = 0; Shard < Count && !Force; ++Shard) {
+        std::string Owner;
+        if (Exists(LockPath(Spool, Shard)) && !Stale(Spool, Shard, Owner)) {
+            Error = LockPath(Spool, Shard) + ": held by " + Owner + " (--force removes it)";
+            return false;
+        }
+    }
+
+    // Results of a previous run with more shards must not be merged
+    for (size_t Shard = 0; Shard < Count; ++Shard) {
+        Release(Spool, Shard);
+        if (Shard >= Shards.size())
+            ::unlink(ResultPath(Spool, Shard).c_str());
+    }
+
+    for (size_t Shard = 0; Shard < Shards.size(); ++Shard) {
+        std::string Inputs;
+        std::string Key = Options + "\n";
+        for (const auto &Input : Shards[Shard]) {
+            Inputs += Input + "\n";
+            Key += Input + "\t" + FileKey(Input) + "\n";
+        }
+
+        std::string Old;
+        if (Resume && ReadFile(KeyPath(Spool, Shard), Old) && Old == Key && ReadFile(InputsPath(Spool, Shard), Old) &&
+            Old == Inputs)
+            continue;
+
+        // The result goes first, a crash in between leaves no stale pair
+        ::unlink(ResultPath(Spool, Shard).c_str());
+        if (!Publish(InputsPath(Spool, Shard), Inputs) || !Publish(KeyPath(Spool, Shard), Key)) {
+            Error = ShardPath(Spool, Shard, "") + ": " + std::strerror(errno);
+            return false;
+        }
+    }
+
+    if (!Publish(Spool + "/manifest", std::to_string(Shards.size()) + "\n")) {
+        Error = Spool + "/manifest: " + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+// Runs every shard of the spool in child processes, Parallel at a time:
+// Program with Args and "--shard=<i>". A shard whose process fails is run
+// again up to Retries times. Shards claimed by helpers on other nodes are
+// left to them while there is other work; once there is none, idle slots
+// run them as backups, and a backup is stopped as soon as the helper's
+// result appears. Returns the shards left without a result.
+class Coordinator {
+private:
+    std::string Spool;
+    unsigned Parallel;
+    unsigned Retries;
+
+private:
+    pid_t Spawn(const std::string &Program, const std::vector<std::string> &Args, size_t Shard) const {
+        std::vector<std::string> Arguments = {Program};
+        Arguments.insert(Arguments.end(), Args.begin(), Args.end());
+        Arguments.push_back("--shard=" + std::to_string(Shard));
+
+        std::vector<char *> Argv;
+        for (auto &Argument : Arguments)
+            Argv.push_back(&Argument[0]);
+        Argv.push_back(nullptr);
+
+        pid_t Pid = -1;
+        if (int Error = ::posix_spawn(&Pid, Program.c_str(), nullptr, nullptr, Argv.data(), environ)) {
+            errno = Error;
+            return -1;
+        }
+        return Pid;
+    }
+
+public:
+    Coordinator(std::string Spool, unsigned Parallel, unsigned Retries)
+        : Spool(std::move(Spool)), Parallel(std::max(1u, Parallel)), Retries(Retries) {}
+
+public:
+    std::vector<size_t> Run(const std::string &Program, const std::vector<std::string> &Args) {
+        size_t Shards = ShardCount(Spool);
+        std::vector<unsigned> Attempts(Shards);
+        std::vector<bool> Owned(Shards);
+        std::map<pid_t, size_t> Running;
+
+        auto IsRunning = [&Running](size_t Shard) {
+            return std::any_of(Running.begin(), Running.end(), [Shard](const auto &Entry) {
+                return Entry.second == Shard;
+            });
+        };
+        auto Launch = [&](size_t Shard) {
+            ++Attempts[Shard];
+            pid_t Pid = Spawn(Program, Args, Shard);
+            if (Pid < 0) {
+                std::cerr << "Ошибка: не удалось запустить шард " << Shard << ": " << std::strerror(errno)
+                          << std::endl;
+                if (Owned[Shard])
+                    Release(Spool, Shard);
+                Owned[Shard] = false;
+                return;
+            }
+            Running[Pid] = Shard;
+        };
+
+        while (true) {
+            bool Waiting = false;
+            for (size_t Shard = 0; Shard < Shards; ++Shard) {
+                if (Exists(ResultPath(Spool, Shard)) || IsRunning(Shard) || Attempts[Shard] > Retries)
+                    continue;
+                Waiting = true;
+                if (Running.size() < Parallel && Claim(Spool, Shard)) {
+                    Owned[Shard] = true;
+                    Launch(Shard);
+                }
+            }
+
+            // Backups of the shards helpers hold
+            for (size_t Shard = 0; Shard < Shards && Running.size() < Parallel; ++Shard)
+                if (!Exists(ResultPath(Spool, Shard)) && !IsRunning(Shard) && Attempts[Shard] <= Retries)
+                    Launch(Shard);
+
+            for (const auto &[Pid, Shard] : Running)
+                if (!Owned[Shard] && Exists(ResultPath(Spool, Shard)))
+                    ::kill(Pid, SIGTERM);
+
+            if (Running.empty() && !Waiting)
+                break;
+
+            // Polled, results of helpers appear without a child exiting
+            int Status = 0;
+            pid_t Pid = ::waitpid(-1, &Status, WNOHANG);
+            if (Pid <= 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                continue;
+            }
+
+            auto Found = Running.find(Pid);
+            if (Found == Running.end())
+                continue;
+            size_t Shard = Found->second;
+            Running.erase(Found);
+            if (Owned[Shard])
+                Release(Spool, Shard);
+            Owned[Shard] = false;
+
+            if (Exists(ResultPath(Spool, Shard)))
+                continue;
+            if (WIFSIGNALED(Status))
+                std::cerr << "Ошибка: шард " << Shard << " завершился по сигналу " << WTERMSIG(Status);
+            else
+                std::cerr << "Ошибка: шард " << Shard << " завершился с кодом " << WEXITSTATUS(Status);
+            std::cerr << (Attempts[Shard] > Retries ? "" : ", повтор") << std::endl;
+        }
+
+        std::vector<size_t> Missing;
+        for (size_t Shard = 0; Shard < Shards; ++Shard)
+            if (!Exists(ResultPath(Spool, Shard)))
+                Missing.push_back(Shard);
+        return Missing;
+    }
+};
+
+}
@@ -2,9 +2,13 @@
 
 #include <vector>
 #include <iostream>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "control_flow/context.hpp"
 #include "abreu/context.hpp"
+#include "filter.hpp"
+#include "scheduler.hpp"
 
 #include "clang/AST/RecursiveASTVisitor.h"
 
@@ -14,34 +18,196 @@ class Visitor : public RecursiveASTVisitor<Visitor>
 {
 private:
     ASTContext *Context;
+    ToolOptions Options;
+    PathFilter Filter;
+    bool BuildCfg = false;
 
 private:
     cfg::Context CfgCtx;
     abreu::Context AbreuCtx;
 
+private:
+    std::unordered_set<const CXXRecordDecl*> Processed;
+    std::unordered_map<const CXXRecordDecl*, abreu::ast::Class*> PatternClasses;
+    // Bodies left to BuildPending, in traversal order
+    std::vector<FunctionDecl*> Pending;
+
 public:
-    Visitor(ASTContext *Context) : Context(Context) {}
+    // Functions whose control flow the backend could not build
+    std::vector<std::string> Unsupported;
+
+public:
+    Visitor(ASTContext *Context, const ToolOptions &Options = {}, bool BuildCfg = false)
+        : Context(Context), Options(Options), Filter(Context->getSourceManager(), Options), BuildCfg(BuildCfg) {}
+
+    std::vector<std::string> Render() {
+        if (Options.Format == OutputFormat::Svg)
+            return CfgCtx.RenderSvg();
+        return CfgCtx.Render();
+    }
+
+    cfg::graphiz::CoalesceStats Coalesce() {
+        return CfgCtx.Coalesce();
+    }
+
+    void Stats(std::ostream &out) {
+        AbreuCtx.Stats(out);
+    }
 
-    void Draw(std::ofstream &ofstream) {
-        CfgCtx.Draw(ofstream);
+    const cfg::Context &Cfg() const { return CfgCtx; }
+
+    cfg::CallGraph Calls() const { return CfgCtx.Calls.Build(); }
+
+    std::vector<std::string> RenderLoops(cfg::Context::LoopTotals &Totals) const {
+        return CfgCtx.RenderLoops(Totals);
+    }
+
+    cfg::graphiz::FingerprintIndex Fingerprints(bool Labels) const { return CfgCtx.Fingerprints(Labels); }
+
+    std::vector<std::string> RenderDataflow(cfg::Context::DataflowTotals &Totals,
+                                            std::vector<std::string> &Warnings) const {
+        return CfgCtx.RenderDataflow(Totals, Warnings);
     }
 
-    void Stats() {
-        AbreuCtx.Stats();
+    const abreu::Context &Abreu() const { return AbreuCtx; }
+
+    // Builds the bodies collected during traversal. Chunks of consecutive
+    // functions are built into arenas of their own as pool subtasks and
+    // appended in order, so the output does not depend on who ran what.
+    // Only the builder backend reads the AST without changing it; clang::CFG
+    // allocates in the ASTContext and is built during traversal.
+    void BuildPending() {
+        struct Chunk {
+            cfg::Arena Nodes;
+            std::vector<cfg::ast::Node*> Functions;
+            std::vector<std::string> Unsupported;
+        };
+
+        size_t Size = std::max<size_t>(16, Pending.size() / (Options.Pool ? Options.Pool->size() * 4 : 1));
+        std::vector<Chunk> Chunks((Pending.size() + Size - 1) / Size);
+        auto Build = [this, Size, &Chunks](size_t Index) {
+            Chunk &Chunk = Chunks[Index];
+            size_t End = std::min(Pending.size(), (Index + 1) * Size);
+            for (size_t Func = Index * Size; Func < End; ++Func) {
+                try {
+                    Chunk.Functions.push_back(cfg::CreateFunction(Pending[Func], Context, Options.Backend, Chunk.Nodes));
+                } catch (std::exception&) {
+                    Chunk.Unsupported.push_back(Pending[Func]->getNameAsString());
+                }
+            }
+        };
+
+        if (Options.Pool && Pending.size() > Options.SplitFunctions && Chunks.size() > 1) {
+            TaskPool::Group Group;
+            for (size_t Index = 1; Index < Chunks.size(); ++Index)
+                Options.Pool->Spawn([&Build, Index] { Build(Index); }, Group);
+            Build(0);
+            Options.Pool->Wait(Group);
+        } else {
+            for (size_t Index = 0; Index < Chunks.size(); ++Index)
+                Build(Index);
+        }
+
+        for (auto &Chunk : Chunks) {
+            CfgCtx.Nodes.Adopt(std::move(Chunk.Nodes));
+            for (auto *Func : Chunk.Functions)
+                CfgCtx.Push(Func);
+            Unsupported.insert(Unsupported.end(), Chunk.Unsupported.begin(), Chunk.Unsupported.end());
+        }
+        Pending.clear();
     }
 
 public:
+    // Declarations from filtered out files are not descended into, so whole
+    // system-header namespaces are skipped at once
+    bool TraverseDecl(Decl *D) {
+        if (D && !llvm::isa<TranslationUnitDecl>(D) && !Filter.Accepts(D->getLocation()))
+            return true;
+
+        // Calls met inside a body belong to the function being traversed
+        auto *Func = llvm::dyn_cast_or_null<FunctionDecl>(D);
+        if (!BuildCfg || !Func || !Func->doesThisDeclarationHaveABody())
+            return RecursiveASTVisitor::TraverseDecl(D);
+
+        CfgCtx.Calls.Enter(Func);
+        bool Result = RecursiveASTVisitor::TraverseDecl(D);
+        CfgCtx.Calls.Leave();
+        return Result;
+    }
+
+    bool shouldVisitTemplateInstantiations() const {
+        return Options.Templates == TemplatePolicy::Instantiations;
+    }
+
     bool VisitCXXRecordDecl(CXXRecordDecl* Record) {
-        AbreuCtx.Push(new abreu::ast::Class(Record, Context));
+        // clang-cfg analyses classes only when asked for the factors as well
+        if (BuildCfg && !Options.Metrics)
+            return true;
+        // Forward declarations, redeclarations, injected class names and closures
+        if (Record->getDefinition() != Record || Record->isInjectedClassName() || Record->isLambda())
+            return true;
+        if (!Processed.insert(Record).second)
+            return true;
+
+        if (isTemplateInstantiation(Record->getTemplateSpecializationKind())) {
+            if (Options.Templates == TemplatePolicy::Primary)
+                return true;
+
+            CXXRecordDecl* Pattern = Record->getTemplateInstantiationPattern();
+            if (!Pattern)
+                return true;
+
+            abreu::ast::Class*& Cached = PatternClasses[Pattern];
+            if (!Cached)
+                Cached = AbreuCtx.Make(Pattern, Context, !Options.SkipFunctionBodies);
+            AbreuCtx.Push(Cached, Record);
+            return true;
+        }
+
+        // Patterns are accounted through their instantiations
+        bool IsPattern = Record->getDescribedClassTemplate() || isa<ClassTemplatePartialSpecializationDecl>(Record);
+        if (IsPattern && Options.Templates == TemplatePolicy::Instantiations)
+            return true;
+
+        AbreuCtx.Push(AbreuCtx.Make(Record, Context, !Options.SkipFunctionBodies));
+        return true;
+    }
+
+    bool VisitFunctionDecl(FunctionDecl *FuncDecl) {
+        if (!BuildCfg || !FuncDecl->doesThisDeclarationHaveABody())
+            return true;
+        if (FuncDecl->isTemplateInstantiation())
+            return true;
+
+        if (Options.Pool && Options.SplitFunctions && Options.Backend == CfgBackend::Builder) {
+            Pending.push_back(FuncDecl);
+            return true;
+        }
+
+        try {
+            CfgCtx.Push(cfg::CreateFunction(FuncDecl, Context, Options.Backend, CfgCtx.Nodes));
+        } catch (std::exception&) {
+            Unsupported.push_back(FuncDecl->getNameAsString());
+        }
+        return true;
+    }
+
+    // Member calls are CallExprs as well, their callee is the CXXMethodDecl
+    bool VisitCallExpr(CallExpr *Call) {
+        if (!BuildCfg)
+            return true;
+        if (const FunctionDecl *Callee = Call->getDirectCallee())
+            CfgCtx.Calls.Record(Callee);
         return true;
     }
-    // bool VisitFunctionDecl(FunctionDecl *FuncDecl) {
-        // CfgCtx.Push(new cfg::ast::Function(FuncDecl, Context));
-        // return true;
-    // }
 
     bool VisitTranslationUnitDecl(TranslationUnitDecl* stmt) {
-        stmt->dump();
+        if (!Options.DumpAST)
+            return true;
+
+        for (auto* D : stmt->decls())
+            if (Filter.Accepts(D->getLocation()))
+                D->dump();
 
         return true;
     }
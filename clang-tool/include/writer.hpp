@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Writes output files on a dedicated thread. Producers hand over finished
+// buffers and continue; they only wait when the bounded queue is full.
+// Every file is written with as few writev calls as its chunks allow, or,
+// in direct mode, in large aligned blocks that O_DIRECT accepts.
+class OutputWriter {
+public:
+    struct Job {
+        std::string Path;
+        std::vector<std::string> Chunks;
+    };
+
+    // O_DIRECT wants block-aligned buffers, sizes and offsets
+    static constexpr size_t Alignment = 4096;
+    static constexpr size_t BlockSize = 1 << 20;
+
+private:
+    size_t Capacity;
+    bool DirectIO;
+
+    std::deque<Job> Queue;
+    std::mutex Mutex;
+    std::condition_variable NotEmpty;
+    std::condition_variable NotFull;
+    bool Closed = false;
+    size_t Failed = 0;
+
+    std::thread Thread;
+
+private:
+    void Report(const std::string &Path, int Error) {
+        std::cerr << "Ошибка: не удалось записать файл " << Path << ": " << std::strerror(Error) << std::endl;
+        Failed++;
+    }
+
+    bool WriteAll(int Fd, std::vector<iovec> &Vec) {
+        size_t Next = 0;
+        while (Next < Vec.size()) {
+            int Count = std::min<size_t>(Vec.size() - Next, IOV_MAX);
+            ssize_t Written = ::writev(Fd, Vec.data() + Next, Count);
+            if (Written < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            // Skip what was written, partial writes resume mid-chunk
+            while (Written > 0 && Next < Vec.size()) {
+                size_t Step = std::min<size_t>(Written, Vec[Next].iov_len);
+                Vec[Next].iov_base = static_cast<char *>(Vec[Next].iov_base) + Step;
+                Vec[Next].iov_len -= Step;
+                Written -= Step;
+                if (Vec[Next].iov_len == 0)
+                    Next++;
+            }
+        }
+        return true;
+    }
+
+    bool WriteBuffered(const Job &Job) {
+        int Fd = ::open(Job.Path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (Fd < 0)
+            return false;
+
+        std::vector<iovec> Vec;
+        for (const auto &Chunk : Job.Chunks)
+            if (!Chunk.empty())
+                Vec.push_back({const_cast<char *>(Chunk.data()), Chunk.size()});
+
+        bool Ok = WriteAll(Fd, Vec);
+        return ::close(Fd) == 0 && Ok;
+    }
+
+    bool WriteDirect(const Job &Job) {
+#ifdef O_DIRECT
+        int Fd = ::open(Job.Path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        // Not every file system supports it (tmpfs does not)
+        if (Fd < 0 && errno == EINVAL)
+            return WriteBuffered(Job);
+        if (Fd < 0)
+            return false;
+
+        void *Block = nullptr;
+        if (::posix_memalign(&Block, Alignment, BlockSize) != 0) {
+            ::close(Fd);
+            return WriteBuffered(Job);
+        }
+
+        size_t Total = 0;
+        size_t Filled = 0;
+        bool Ok = true;
+        auto Flush = [&](size_t Size) {
+            std::vector<iovec> Vec = {{Block, Size}};
+            Ok = Ok && WriteAll(Fd, Vec);
+            Filled = 0;
+        };
+
+        for (const auto &Chunk : Job.Chunks) {
+            for (size_t Offset = 0; Offset < Chunk.size();) {
+                size_t Step = std::min(Chunk.size() - Offset, BlockSize - Filled);
+                std::memcpy(static_cast<char *>(Block) + Filled, Chunk.data() + Offset, Step);
+                Filled += Step;
+                Offset += Step;
+                Total += Step;
+                if (Filled == BlockSize)
+                    Flush(BlockSize);
+            }
+        }
+
+        // The tail is padded to the alignment and cut back afterwards
+        if (Filled) {
+            size_t Padded = (Filled + Alignment - 1) / Alignment * Alignment;
+            std::memset(static_cast<char *>(Block) + Filled, 0, Padded - Filled);
+            Flush(Padded);
+        }
+
+        std::free(Block);
+        Ok = Ok && ::ftruncate(Fd, Total) == 0;
+        return ::close(Fd) == 0 && Ok;
+#else
+        return WriteBuffered(Job);
+#endif
+    }
+
+    void Run() {
+        std::deque<Job> Batch;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> Lock(Mutex);
+                NotEmpty.wait(Lock, [this] { return Closed || !Queue.empty(); });
+                if (Queue.empty())
+                    return;
+                // Take everything queued so far in one go
+                Batch.swap(Queue);
+            }
+            NotFull.notify_all();
+
+            for (const auto &Job : Batch) {
+                bool Ok = DirectIO ? WriteDirect(Job) : WriteBuffered(Job);
+                if (!Ok) {
+                    int Error = errno;
+                    std::lock_guard<std::mutex> Lock(Mutex);
+                    Report(Job.Path, Error);
+                }
+            }
+            Batch.clear();
+        }
+    }
+
+public:
+    explicit OutputWriter(size_t Capacity = 64, bool DirectIO = false)
+        : Capacity(std::max<size_t>(1, Capacity)), DirectIO(DirectIO), Thread([this] { Run(); }) {}
+
+    OutputWriter(const OutputWriter &) = delete;
+    OutputWriter &operator=(const OutputWriter &) = delete;
+
+    ~OutputWriter() { Close(); }
+
+public:
+    // Replaces the file at Path with the concatenation of Chunks
+    void Write(std::string Path, std::vector<std::string> Chunks) {
+        {
+            std::unique_lock<std::mutex> Lock(Mutex);
+            NotFull.wait(Lock, [this] { return Queue.size() < Capacity; });
+            Queue.push_back({std::move(Path), std::move(Chunks)});
+        }
+        NotEmpty.notify_one();
+    }
+
+    // Waits until everything queued is on disk
+    void Close() {
+        {
+            std::lock_guard<std::mutex> Lock(Mutex);
+            if (Closed)
+                return;
+            Closed = true;
+        }
+        NotEmpty.notify_one();
+        Thread.join();
+    }
+
+    size_t Failures() {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        return Failed;
+    }
+};
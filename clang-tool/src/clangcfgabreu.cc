@@ -0,0 +1,106 @@
+#include "clangcfgabreu.hpp"
+
+#include "clang/AST/ASTConsumer.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendAction.h"
+
+#include "control_flow/fingerprint.hpp"
+#include "control_flow/index.hpp"
+#include "control_flow/loops.hpp"
+#include "input.hpp"
+#include "visitor.hpp"
+
+namespace clangcfgabreu {
+
+namespace {
+
+FunctionGraph Flatten(cfg::graphiz::FlowNode *Root) {
+    cfg::graphiz::Index Index(Root);
+
+    FunctionGraph Graph;
+    Graph.Nodes.resize(Index.size());
+    for (size_t Id = 0; Id < Index.size(); ++Id) {
+        auto &Node = Graph.Nodes[Id];
+        Node.Label = Index.Nodes[Id]->getNodeLabel();
+        Node.Shape = Index.Nodes[Id]->getNodeShape();
+        Node.SuccT = Index.SuccT[Id];
+        Node.SuccF = Index.SuccF[Id];
+    }
+
+    Graph.Fingerprint = cfg::graphiz::fingerprint(Index, true);
+    Graph.StructuralFingerprint = cfg::graphiz::fingerprint(Index, false);
+
+    cfg::graphiz::LoopForest Forest(Index);
+    Graph.LoopDepth = std::move(Forest.Depth);
+    Graph.LoopOf = std::move(Forest.LoopOf);
+    Graph.Loops = std::move(Forest.Loops);
+    return Graph;
+}
+
+struct AnalysisConsumer : clang::ASTConsumer {
+private:
+    Analysis &Result;
+    ToolOptions Options;
+
+public:
+    AnalysisConsumer(Analysis &Result, const ToolOptions &Options) : Result(Result), Options(Options) {}
+
+    void HandleTranslationUnit(clang::ASTContext &Context) override {
+        Result = Analyze(Context, Options);
+    }
+};
+
+struct AnalysisAction : clang::ASTFrontendAction {
+private:
+    Analysis &Result;
+    ToolOptions Options;
+
+public:
+    AnalysisAction(Analysis &Result, const ToolOptions &Options) : Result(Result), Options(Options) {}
+
+    std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(clang::CompilerInstance &Compiler,
+                                                          llvm::StringRef InFile) override {
+        return std::make_unique<AnalysisConsumer>(Result, Options);
+    }
+};
+
+}
+
+Analysis Analyze(clang::ASTContext &Context, const ToolOptions &Options) {
+    // Both results, from the one traversal
+    ToolOptions Unified = Options;
+    Unified.Metrics = true;
+    ::Visitor Visitor(&Context, Unified, true);
+    Visitor.TraverseDecl(Context.getTranslationUnitDecl());
+    // With a Pool set the bodies were only queued
+    Visitor.BuildPending();
+    if (Options.Coalesce)
+        Visitor.Coalesce();
+
+    Analysis Result;
+    for (auto *Func : Visitor.Cfg().Functions)
+        Result.Functions.push_back(Flatten(Func->FlowStart()));
+    Result.Unsupported = Visitor.Unsupported;
+    Result.Calls = Visitor.Calls();
+    for (const auto &Chunk : Visitor.Cfg().Render())
+        Result.Dot += Chunk;
+
+    Result.Metrics = Visitor.Abreu().Compute();
+    return Result;
+}
+
+bool AnalyzeBuffer(llvm::StringRef Code, llvm::StringRef FileName, Analysis &Result, std::string &Error,
+                   const ToolOptions &Options, const std::vector<std::string> &Args) {
+    // The lexer reads up to a null terminator Code need not have: a copy
+    // gets one
+    std::unique_ptr<llvm::MemoryBuffer> Buffer = llvm::MemoryBuffer::getMemBufferCopy(Code, FileName);
+    return runToolOnBuffer(std::make_unique<AnalysisAction>(Result, Options), FileName, Buffer->getMemBufferRef(),
+                           Error, Args);
+}
+
+bool AnalyzeFile(llvm::StringRef Path, Analysis &Result, std::string &Error, const ToolOptions &Options,
+                 const std::vector<std::string> &Args) {
+    return runToolOnFile(std::make_unique<AnalysisAction>(Result, Options), Path, Error, Args);
+}
+
+}
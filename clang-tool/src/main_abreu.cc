@@ -4,8 +4,14 @@
 #include "clang/Tooling/CommonOptionsParser.h"
 #include "clang/Tooling/Tooling.h"
 
+#include "abreu/sampling.hpp"
+#include "abreu/summary.hpp"
 #include "action.hpp"
+#include "input.hpp"
+#include "shard.hpp"
 
+#include <cmath>
+#include <sstream>
 #include <string>
 
 using namespace std;
@@ -13,25 +19,333 @@ using namespace llvm;
 using namespace clang;
 using namespace clang::tooling;
 
+static cl::OptionCategory AbreuCategory("clang-abreu options");
+
+static cl::list<std::string> InputFilenames(cl::Positional, cl::desc("<input files, sources or .ast/.pch>"),
+    cl::cat(AbreuCategory));
+
+static cl::opt<std::string> BuildPath("p", cl::desc("Build directory with compile_commands.json (all its files "
+    "when no input is given)"), cl::cat(AbreuCategory));
+
+static cl::opt<std::string> MetricsFilename("o", cl::desc("Write the metrics to a file instead of stdout"),
+    cl::cat(AbreuCategory));
+
+static cl::opt<Compression> Compress("compress", cl::desc("Compress the output"),
+    cl::values(clEnumValN(Compression::None, "none", "Plain text"),
+               clEnumValN(Compression::Zlib, "zlib", "gzip (.gz)"),
+               clEnumValN(Compression::Zstd, "zstd", "zstd (.zst)")),
+    cl::init(Compression::None), cl::cat(AbreuCategory));
+
+static cl::opt<unsigned> CompressThreads("compress-threads", cl::desc("Threads compressing blocks (0: all cores)"),
+    cl::init(0), cl::cat(AbreuCategory));
+
+static cl::opt<bool> MainFileOnly("main-file-only", cl::desc("Analyse declarations from the main file only"),
+    cl::init(false), cl::cat(AbreuCategory));
+
+static cl::opt<bool> SkipSystemHeaders("skip-system-headers", cl::desc("Do not descend into system headers"),
+    cl::init(true), cl::cat(AbreuCategory));
+
+static cl::list<std::string> IncludeGlobs("include-path", cl::desc("Analyse only files matching the glob"),
+    cl::ZeroOrMore, cl::cat(AbreuCategory));
+
+static cl::list<std::string> ExcludeGlobs("exclude-path", cl::desc("Skip files matching the glob"),
+    cl::ZeroOrMore, cl::cat(AbreuCategory));
+
+static cl::opt<bool> DumpAST("dump-ast", cl::desc("Dump the analysed part of the AST"), cl::cat(AbreuCategory));
+
+static cl::opt<bool> SkipFunctionBodies("skip-function-bodies",
+    cl::desc("Parse declarations only (off: CF also counts the classes method bodies use)"),
+    cl::init(true), cl::cat(AbreuCategory));
+
+static cl::opt<bool> DelayedTemplateParsing("delayed-template-parsing",
+    cl::desc("Do not parse template bodies (MSVC-style lookup)"), cl::cat(AbreuCategory));
+
+static cl::opt<TemplatePolicy> Templates("templates", cl::desc("How class templates are counted"),
+    cl::values(clEnumValN(TemplatePolicy::Primary, "primary", "Count each template once"),
+               clEnumValN(TemplatePolicy::Instantiations, "instantiations",
+                          "Count every instantiation, analysed once per pattern")),
+    cl::init(TemplatePolicy::Primary), cl::cat(AbreuCategory));
+
+static cl::opt<std::string> ReportFilename("report",
+    cl::desc("Write the classes contributing most to every factor and histograms of the per-class counts"),
+    cl::cat(AbreuCategory));
+
+static cl::opt<unsigned> TopK("top", cl::desc("Classes listed per factor in the report"), cl::init(10),
+    cl::cat(AbreuCategory));
+
+static cl::opt<double> SampleFiles("sample", cl::desc("Analyse a random fraction of the input files"),
+    cl::init(1.0), cl::cat(AbreuCategory));
+
+static cl::opt<double> SampleClasses("sample-classes", cl::desc("Keep a random fraction of the classes of every file"),
+    cl::init(1.0), cl::cat(AbreuCategory));
+
+static cl::opt<unsigned long long> SampleSeed("sample-seed", cl::desc("Seed of the file and class samples"),
+    cl::init(1), cl::cat(AbreuCategory));
+
+static cl::opt<bool> Stratify("stratify", cl::desc("Sample the input files evenly across their directories"),
+    cl::cat(AbreuCategory));
+
+static cl::opt<double> Tolerance("tolerance",
+    cl::desc("Stop once every factor is known within +/- this much (0: analyse the whole sample)"),
+    cl::init(0), cl::cat(AbreuCategory));
+
+static cl::opt<unsigned> Bootstrap("bootstrap", cl::desc("Bootstrap replicates of the confidence intervals"),
+    cl::init(200), cl::cat(AbreuCategory));
+
+static cl::opt<double> Confidence("confidence", cl::desc("Confidence level of the intervals"), cl::init(0.95),
+    cl::cat(AbreuCategory));
+
+static cl::opt<unsigned> Shards("shards",
+    cl::desc("Analyse in this many worker processes, merging their summaries (0: in this process)"),
+    cl::init(0), cl::cat(AbreuCategory));
+
+static cl::opt<std::string> Spool("spool", cl::desc("Directory shared by the coordinator and the workers"),
+    cl::init("clang-abreu.spool"), cl::cat(AbreuCategory));
+
+static cl::opt<bool> Resume("resume",
+    cl::desc("Keep results of shards whose options, inputs, sizes and mtimes are unchanged since the last run"),
+    cl::cat(AbreuCategory));
+
+static cl::opt<bool> Force("force",
+    cl::desc("Prepare the spool even if locks of processes that may still run are in it"), cl::cat(AbreuCategory));
+
+static cl::opt<unsigned> Retries("retries", cl::desc("Times a failed shard is run again"), cl::init(2),
+    cl::cat(AbreuCategory));
+
+static cl::opt<bool> Helper("helper",
+    cl::desc("Run unclaimed shards of the spool of a coordinator, e.g. on another node"), cl::cat(AbreuCategory));
+
+static cl::opt<int> Shard("shard", cl::desc("Run one shard of the spool (started by the coordinator)"),
+    cl::init(-1), cl::Hidden, cl::cat(AbreuCategory));
+
+// A source through the frontend, a serialized AST straight from the file
+static bool Analyse(const ToolOptions &Options, const CompilationDatabase *Database, const std::string &Input,
+                    std::string &Error) {
+    std::string Directory;
+    std::vector<std::string> Args;
+    if (Database)
+        Args = CompileArgs(*Database, Input, Directory);
+    if (IsSerializedAST(Input))
+        return runConsumerOnAST<AbreuConsumer>(Input, Options, Error, Directory);
+    return runToolOnFile(std::make_unique<AbreuAction>(Options), Input, Error, Args, Directory);
+}
+
+// Parses the files of a shard and publishes their merged summaries. Files
+// the frontend rejects are reported and left out, running them again would
+// not help; a crash leaves no result and the shard is retried.
+static bool AnalyseShard(const ToolOptions &Options, const CompilationDatabase *Database, size_t Index) {
+    abreu::Project Project;
+    for (const auto &Input : shard::Inputs(Spool, Index)) {
+        std::vector<abreu::ClassSummary> Summaries;
+        ToolOptions ShardOptions = Options;
+        ShardOptions.Summaries = &Summaries;
+        std::string Error;
+        if (!Analyse(ShardOptions, Database, Input, Error))
+            std::cerr << "Ошибка: не удалось обработать файл " << Input << ": " << Error << std::endl;
+        Project.Add(std::move(Summaries));
+    }
+
+    std::ostringstream out;
+    Project.Write(out);
+    if (!shard::Publish(shard::ResultPath(Spool, Index), out.str())) {
+        std::cerr << "Ошибка: не удалось записать результат шарда " << Index << std::endl;
+        return false;
+    }
+    return true;
+}
+
 int main(int argc, char **argv) {
-    if (argc > 1) {
-        std::ifstream inputFile(argv[1]);
-        
-        if (!inputFile.is_open()) {
-            std::cerr << "Ошибка: не удалось открыть файл " << argv[1] << std::endl;
+    cl::HideUnrelatedOptions(AbreuCategory);
+    cl::ParseCommandLineOptions(argc, argv);
+
+    ToolOptions Options;
+    Options.Compress = Compress;
+    Options.CompressThreads = CompressThreads;
+    if (!MetricsFilename.empty())
+        Options.MetricsOutput = compress::OutputPath(MetricsFilename, Compress);
+    if (!ReportFilename.empty())
+        Options.ReportOutput = compress::OutputPath(ReportFilename, Compress);
+    Options.TopK = TopK;
+    Options.MainFileOnly = MainFileOnly;
+    Options.SkipSystemHeaders = SkipSystemHeaders;
+    Options.IncludeGlobs = IncludeGlobs;
+    Options.ExcludeGlobs = ExcludeGlobs;
+    Options.DumpAST = DumpAST;
+    Options.SkipFunctionBodies = SkipFunctionBodies;
+    Options.DelayedTemplateParsing = DelayedTemplateParsing;
+    Options.Templates = Templates;
+
+    std::vector<llvm::GlobPattern> Patterns;
+    std::string Error;
+    if (!CompileGlobs(Options.IncludeGlobs, Patterns, Error) || !CompileGlobs(Options.ExcludeGlobs, Patterns, Error)) {
+        std::cerr << "Ошибка: неверный шаблон пути " << Error << std::endl;
+        return 1;
+    }
+
+    if (!compress::Available(Compress, Error)) {
+        std::cerr << "Ошибка: сжатие недоступно: " << Error << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<CompilationDatabase> Database;
+    if (!BuildPath.empty()) {
+        Database = CompilationDatabase::loadFromDirectory(BuildPath, Error);
+        if (!Database) {
+            std::cerr << "Ошибка: не удалось загрузить базу компиляции: " << Error << std::endl;
             return 1;
         }
+    }
 
-        std::string code((std::istreambuf_iterator<char>(inputFile)),
-                          std::istreambuf_iterator<char>());
+    if (Shard >= 0)
+        return AnalyseShard(Options, Database.get(), Shard) ? 0 : 1;
 
-        inputFile.close();
+    if (Helper) {
+        for (size_t Index = 0; Index < shard::ShardCount(Spool); ++Index) {
+            if (shard::Exists(shard::ResultPath(Spool, Index)) || !shard::Claim(Spool, Index))
+                continue;
+            bool Done = AnalyseShard(Options, Database.get(), Index);
+            shard::Release(Spool, Index);
+            if (!Done)
+                return 1;
+        }
+        return 0;
+    }
 
-        clang::tooling::runToolOnCode(std::make_unique<AbreuAction>(), code);
-    } else {
+    std::vector<std::string> Inputs(InputFilenames.begin(), InputFilenames.end());
+    if (Inputs.empty() && Database)
+        Inputs = Database->getAllFiles();
+    if (Inputs.empty()) {
         std::cerr << "Ошибка: укажите путь до файла как аргумент командной строки." << std::endl;
         return 1;
     }
 
-    return 0;
+    if (Shards && Tolerance > 0) {
+        std::cerr << "Ошибка: --tolerance не совместим с --shards" << std::endl;
+        return 1;
+    }
+
+    bool Sampling = SampleFiles < 1 || SampleClasses < 1 || Tolerance > 0;
+    if (Inputs.size() == 1 && !Sampling && !Shards) {
+        if (!Analyse(Options, Database.get(), Inputs[0], Error)) {
+            std::cerr << "Ошибка: не удалось обработать файл " << Inputs[0] << ": " << Error << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // Several files: every TU is reduced to class summaries and its AST
+    // freed, the factors are computed over the merged project. When
+    // sampling, files are taken from the start of a seeded random order
+    std::vector<size_t> Order(Inputs.size());
+    for (size_t Index = 0; Index < Order.size(); ++Index)
+        Order[Index] = Index;
+    if (Sampling)
+        Order = abreu::SampleOrder(Inputs, SampleSeed, Stratify);
+    size_t Limit = Order.size();
+    if (SampleFiles < 1)
+        Limit = std::max<size_t>(1, std::ceil(SampleFiles * Order.size()));
+
+    abreu::Project Project;
+    auto Records = [&Project]() {
+        std::vector<bool> Keep = abreu::SampleClasses(Project.size(), SampleClasses, SampleSeed);
+        return Project.Records(&Keep);
+    };
+
+    size_t Analysed = 0;
+    size_t NextCheck = 2;
+    bool Failed = false;
+    if (Shards) {
+        // Shards of about equal size; the summaries they publish merge the
+        // same way as those of the files analysed here
+        std::vector<std::string> Sample;
+        std::vector<double> Sizes;
+        for (size_t Position = 0; Position < Limit; ++Position) {
+            Sample.push_back(Inputs[Order[Position]]);
+            uint64_t Size = 0;
+            llvm::sys::fs::file_size(Sample.back(), Size);
+            Sizes.push_back(Size);
+        }
+        // Everything a result depends on besides its inputs: the command
+        // line, without the flags that only say how to treat the spool, and
+        // the compile commands
+        std::string Key;
+        for (int Index = 1; Index < argc; ++Index) {
+            std::string Argument = argv[Index];
+            std::string Name = Argument.substr(0, Argument.find('='));
+            if (Name != "--resume" && Name != "-resume" && Name != "--force" && Name != "-force")
+                Key += Argument + "\t";
+        }
+        if (!BuildPath.empty())
+            Key += shard::FileKey(BuildPath + "/compile_commands.json");
+
+        if (!shard::Prepare(Spool, shard::Split(Sample, Sizes, Shards), Key, Resume, Force, Error)) {
+            std::cerr << "Ошибка: не удалось подготовить каталог " << Error << std::endl;
+            return 1;
+        }
+
+        std::string Program = llvm::sys::fs::getMainExecutable(argv[0], reinterpret_cast<void *>(&AnalyseShard));
+        shard::Coordinator Coordinator(Spool, Shards, Retries);
+        std::vector<size_t> Missing = Coordinator.Run(Program, std::vector<std::string>(argv + 1, argv + argc));
+        for (size_t Index : Missing)
+            std::cerr << "Ошибка: шард " << Index << " не обработан, его файлы не учтены" << std::endl;
+        Failed = !Missing.empty();
+
+        for (size_t Index = 0; Index < shard::ShardCount(Spool); ++Index) {
+            std::string Text;
+            if (!shard::ReadFile(shard::ResultPath(Spool, Index), Text))
+                continue;
+            std::istringstream in(Text);
+            if (!Project.Read(in)) {
+                std::cerr << "Ошибка: повреждён результат шарда " << Index << std::endl;
+                Failed = true;
+            }
+        }
+        Analysed = Limit;
+    } else {
+        for (size_t Position = 0; Position < Limit; ++Position) {
+            const std::string &Input = Inputs[Order[Position]];
+            std::vector<abreu::ClassSummary> Summaries;
+            Options.Summaries = &Summaries;
+            if (!Analyse(Options, Database.get(), Input, Error)) {
+                std::cerr << "Ошибка: не удалось обработать файл " << Input << ": " << Error << std::endl;
+                return 1;
+            }
+            Project.Add(std::move(Summaries));
+            ++Analysed;
+
+            // Intervals are checked on a geometric schedule, each check costs a
+            // bootstrap over everything collected so far
+            if (Tolerance > 0 && Analysed >= NextCheck) {
+                NextCheck = Analysed + std::max<size_t>(1, Analysed / 4);
+                if (abreu::Estimate(Records(), Bootstrap, Confidence, SampleSeed).HalfWidth() <= Tolerance)
+                    break;
+            }
+        }
+    }
+    Options.Summaries = nullptr;
+
+    std::ostringstream out;
+    if (Sampling) {
+        abreu::Estimate Estimate(Records(), Bootstrap, Confidence, SampleSeed);
+        abreu::Print(Estimate.Point, out, &Estimate.Intervals);
+        out << "Sample: " << Analysed << " of " << Inputs.size() << " files, " << Estimate.Classes << " classes, "
+            << Confidence * 100 << "% intervals" << '\n';
+    } else {
+        abreu::Print(Project.Compute(), out);
+    }
+
+    if (!Options.ReportOutput.empty()) {
+        abreu::Outliers Report(Options.TopK);
+        Project.Report(Report);
+        std::ostringstream Text;
+        Report.Print(Text);
+        Emit(Options, Options.ReportOutput, {Text.str()});
+    }
+
+    if (Options.MetricsOutput.empty())
+        std::cout << out.str();
+    else
+        Emit(Options, Options.MetricsOutput, {out.str()});
+
+    return Failed ? 1 : 0;
 }
@@ -4,8 +4,13 @@
 #include "clang/Tooling/CommonOptionsParser.h"
 #include "clang/Tooling/Tooling.h"
 
+#include "abreu/summary.hpp"
 #include "action.hpp"
+#include "input.hpp"
+#include "scheduler.hpp"
 
+#include <atomic>
+#include <chrono>
 #include <string>
 
 using namespace std;
@@ -13,28 +18,292 @@ using namespace llvm;
 using namespace clang;
 using namespace clang::tooling;
 
+static cl::OptionCategory CfgCategory("clang-cfg options");
+
+static cl::list<std::string> InputFilenames(cl::Positional, cl::desc("<input files, sources or .ast/.pch>"),
+    cl::cat(CfgCategory));
+
+static cl::opt<std::string> BuildPath("p", cl::desc("Build directory with compile_commands.json (all its files "
+    "when no input is given)"), cl::cat(CfgCategory));
+
+static cl::opt<unsigned> Jobs("j", cl::desc("Translation units analysed in parallel (0: all cores)"), cl::init(0),
+    cl::cat(CfgCategory));
+
+static cl::opt<std::string> CostHistory("cost-history",
+    cl::desc("Timings of previous runs, read to order the units and updated afterwards"), cl::cat(CfgCategory));
+
+static cl::opt<unsigned> SplitFunctions("split-functions",
+    cl::desc("Build the graphs of a unit with more bodies than this as parallel subtasks (0: never)"),
+    cl::init(256), cl::cat(CfgCategory));
+
+static cl::opt<std::string> OutputFilename("o", cl::desc("Output file (default: graph.dot or graph.svg)"),
+    cl::cat(CfgCategory));
+
+static cl::opt<OutputFormat> Format("format", cl::desc("Output format"),
+    cl::values(clEnumValN(OutputFormat::Dot, "dot", "Graphviz DOT, laid out by dot"),
+               clEnumValN(OutputFormat::Svg, "svg", "SVG with the built-in layered layout")),
+    cl::init(OutputFormat::Dot), cl::cat(CfgCategory));
+
+static cl::opt<std::string> CallGraphFilename("call-graph", cl::desc("Write the call graph of all inputs to the file"),
+    cl::cat(CfgCategory));
+
+static cl::opt<CallGraphFormat> CallGraphFormatOpt("call-graph-format", cl::desc("Call graph format"),
+    cl::values(clEnumValN(CallGraphFormat::Dot, "dot", "Graphviz DOT, recursive components as clusters"),
+               clEnumValN(CallGraphFormat::Binary, "binary", "CSR arrays and components, little-endian")),
+    cl::init(CallGraphFormat::Dot), cl::cat(CfgCategory));
+
+static cl::opt<bool> Loops("loops", cl::desc("Find natural loops and print their count and maximum depth"),
+    cl::cat(CfgCategory));
+
+static cl::opt<std::string> LoopsFilename("loop-stats",
+    cl::desc("Write per-function loop statistics and membership (TSV)"), cl::cat(CfgCategory));
+
+static cl::opt<bool> Dataflow("dataflow",
+    cl::desc("Solve liveness and reaching definitions, warn about unreachable code"), cl::cat(CfgCategory));
+
+static cl::opt<std::string> DataflowFilename("dataflow-stats",
+    cl::desc("Write per-function dataflow statistics (TSV)"), cl::cat(CfgCategory));
+
+static cl::opt<std::string> FingerprintFilename("fingerprints",
+    cl::desc("Write structural fingerprints of the flow graphs, sorted (TSV)"), cl::cat(CfgCategory));
+
+static cl::opt<bool> FingerprintLabels("fingerprint-labels",
+    cl::desc("Hash statement text into the fingerprints, not only structure"), cl::init(true),
+    cl::cat(CfgCategory));
+
+static cl::opt<bool> Metrics("metrics",
+    cl::desc("Compute the MOOD factors of clang-abreu from the same parse. Classes pass the same path filters as "
+             "the graphs: with the default --main-file-only header classes are left out, unlike in clang-abreu"),
+    cl::cat(CfgCategory));
+
+static cl::opt<std::string> MetricsFilename("metrics-output",
+    cl::desc("Write the factors to a file instead of stdout (implies --metrics)"), cl::cat(CfgCategory));
+
+static cl::opt<std::string> ReportFilename("report",
+    cl::desc("Write the classes contributing most to every factor (implies --metrics)"), cl::cat(CfgCategory));
+
+static cl::opt<unsigned> TopK("top", cl::desc("Classes listed per factor in the report"), cl::init(10),
+    cl::cat(CfgCategory));
+
+static cl::opt<Compression> Compress("compress", cl::desc("Compress the output"),
+    cl::values(clEnumValN(Compression::None, "none", "Plain text"),
+               clEnumValN(Compression::Zlib, "zlib", "gzip (.gz)"),
+               clEnumValN(Compression::Zstd, "zstd", "zstd (.zst)")),
+    cl::init(Compression::None), cl::cat(CfgCategory));
+
+static cl::opt<unsigned> CompressThreads("compress-threads", cl::desc("Threads compressing blocks (0: all cores)"),
+    cl::init(0), cl::cat(CfgCategory));
+
+static cl::opt<bool> AsyncOutput("async-output", cl::desc("Write outputs on a separate writer thread"),
+    cl::init(true), cl::cat(CfgCategory));
+
+static cl::opt<unsigned> OutputQueue("output-queue", cl::desc("Outputs waiting for the writer before analysis blocks"),
+    cl::init(64), cl::cat(CfgCategory));
+
+static cl::opt<bool> DirectIO("direct-io", cl::desc("Write outputs with O_DIRECT in large aligned blocks"),
+    cl::cat(CfgCategory));
+
+static cl::opt<bool> Coalesce("coalesce",
+    cl::desc("Merge straight-line statements into basic blocks before rendering"),
+    cl::cat(CfgCategory));
+
+static cl::opt<CfgBackend> Backend("backend", cl::desc("Control flow graph builder"),
+    cl::values(clEnumValN(CfgBackend::Builder, "builder", "Hand-written statement builders"),
+               clEnumValN(CfgBackend::Clang, "clang", "clang::CFG, without switch and computed goto")),
+    cl::init(CfgBackend::Builder), cl::cat(CfgCategory));
+
+static cl::opt<bool> MainFileOnly("main-file-only", cl::desc("Analyse declarations from the main file only"),
+    cl::init(true), cl::cat(CfgCategory));
+
+static cl::opt<bool> SkipSystemHeaders("skip-system-headers", cl::desc("Do not descend into system headers"),
+    cl::init(true), cl::cat(CfgCategory));
+
+static cl::list<std::string> IncludeGlobs("include-path", cl::desc("Analyse only files matching the glob"),
+    cl::ZeroOrMore, cl::cat(CfgCategory));
+
+static cl::list<std::string> ExcludeGlobs("exclude-path", cl::desc("Skip files matching the glob"),
+    cl::ZeroOrMore, cl::cat(CfgCategory));
+
+static cl::opt<bool> DumpAST("dump-ast", cl::desc("Dump the analysed part of the AST"), cl::cat(CfgCategory));
+
 int main(int argc, char **argv) {
-    if (argc > 1) {
-        // Имя файла передаётся вторым аргументом командной строки
-        std::ifstream inputFile(argv[1]);
-        
-        if (!inputFile.is_open()) {
-            std::cerr << "Ошибка: не удалось открыть файл " << argv[1] << std::endl;
-            return 1;
-        }
+    cl::HideUnrelatedOptions(CfgCategory);
+    cl::ParseCommandLineOptions(argc, argv);
 
-        // Считываем содержимое файла в строку
-        std::string code((std::istreambuf_iterator<char>(inputFile)),
-                          std::istreambuf_iterator<char>());
+    ToolOptions Options;
+    Options.Coalesce = Coalesce;
+    Options.Backend = Backend;
+    Options.Compress = Compress;
+    Options.CompressThreads = CompressThreads;
+    Options.Format = Format;
+    std::string Output = OutputFilename;
+    if (Output.empty())
+        Output = Format == OutputFormat::Svg ? "graph.svg" : "graph.dot";
+    Options.Output = compress::OutputPath(Output, Compress);
+    if (!CallGraphFilename.empty())
+        Options.CallGraphOutput = compress::OutputPath(CallGraphFilename, Compress);
+    Options.CallGraph = CallGraphFormatOpt;
+    Options.Loops = Loops || !LoopsFilename.empty();
+    if (!LoopsFilename.empty())
+        Options.LoopsOutput = compress::OutputPath(LoopsFilename, Compress);
+    Options.Dataflow = Dataflow || !DataflowFilename.empty();
+    if (!DataflowFilename.empty())
+        Options.DataflowOutput = compress::OutputPath(DataflowFilename, Compress);
+    if (!FingerprintFilename.empty())
+        Options.FingerprintOutput = compress::OutputPath(FingerprintFilename, Compress);
+    Options.FingerprintLabels = FingerprintLabels;
+    Options.Metrics = Metrics || !MetricsFilename.empty() || !ReportFilename.empty();
+    if (!MetricsFilename.empty())
+        Options.MetricsOutput = compress::OutputPath(MetricsFilename, Compress);
+    if (!ReportFilename.empty())
+        Options.ReportOutput = compress::OutputPath(ReportFilename, Compress);
+    Options.TopK = TopK;
+    Options.MainFileOnly = MainFileOnly;
+    Options.SkipSystemHeaders = SkipSystemHeaders;
+    Options.IncludeGlobs = IncludeGlobs;
+    Options.ExcludeGlobs = ExcludeGlobs;
+    Options.DumpAST = DumpAST;
 
-        inputFile.close();
+    std::vector<llvm::GlobPattern> Patterns;
+    std::string Error;
+    if (!CompileGlobs(Options.IncludeGlobs, Patterns, Error) || !CompileGlobs(Options.ExcludeGlobs, Patterns, Error)) {
+        std::cerr << "Ошибка: неверный шаблон пути " << Error << std::endl;
+        return 1;
+    }
 
-        // Передаём считанный код в clang tool
-        clang::tooling::runToolOnCode(std::make_unique<ControlFlowAction>(), code);
-    } else {
+    if (!compress::Available(Compress, Error)) {
+        std::cerr << "Ошибка: сжатие недоступно: " << Error << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<OutputWriter> Writer;
+    if (AsyncOutput)
+        Writer = std::make_unique<OutputWriter>(OutputQueue, DirectIO);
+    Options.Writer = Writer.get();
+
+    std::unique_ptr<CompilationDatabase> Database;
+    if (!BuildPath.empty()) {
+        Database = CompilationDatabase::loadFromDirectory(BuildPath, Error);
+        if (!Database) {
+            std::cerr << "Ошибка: не удалось загрузить базу компиляции: " << Error << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<std::string> Inputs(InputFilenames.begin(), InputFilenames.end());
+    if (Inputs.empty() && Database)
+        Inputs = Database->getAllFiles();
+    if (Inputs.empty()) {
         std::cerr << "Ошибка: укажите путь до файла как аргумент командной строки." << std::endl;
         return 1;
     }
 
-    return 0;
+    CostModel Costs;
+    if (!CostHistory.empty())
+        Costs.Load(CostHistory);
+
+    struct Unit {
+        size_t Index = 0;
+        std::string Path;
+        std::vector<std::string> Args;
+        std::string Directory;
+        uint64_t Bytes = 0;
+        unsigned Includes = 0;
+        double Cost = 0;
+    };
+
+    // Reading every file up front is cheap next to parsing it
+    std::vector<Unit> Units;
+    for (size_t Index = 0; Index < Inputs.size(); ++Index) {
+        const auto &Input = Inputs[Index];
+        Unit Unit;
+        Unit.Index = Index;
+        Unit.Path = Input;
+        if (Database)
+            Unit.Args = CompileArgs(*Database, Input, Unit.Directory);
+        llvm::SmallString<256> Path(Input);
+        if (!Unit.Directory.empty())
+            llvm::sys::fs::make_absolute(Unit.Directory, Path);
+        if (auto Buffer = llvm::MemoryBuffer::getFile(Path)) {
+            Unit.Bytes = (*Buffer)->getBufferSize();
+            Unit.Includes = CountIncludes((*Buffer)->getBufferStart(), (*Buffer)->getBufferEnd());
+        }
+        Unit.Cost = Costs.Predict(Unit.Path, Unit.Bytes, Unit.Includes);
+        Units.push_back(std::move(Unit));
+    }
+    std::stable_sort(Units.begin(), Units.end(), [](const Unit &Left, const Unit &Right) {
+        return Left.Cost > Right.Cost;
+    });
+
+    TaskPool Pool(Jobs);
+    Options.Pool = &Pool;
+    Options.SplitFunctions = SplitFunctions;
+
+    // Factors of several units are those of the merged project: a class
+    // seen by several units is counted once, not once per unit
+    bool Merge = Options.Metrics && Inputs.size() > 1;
+    std::vector<std::vector<abreu::ClassSummary>> Summaries(Merge ? Inputs.size() : 0);
+    // Likewise one call graph over all units, calls across them included
+    bool MergeCalls = !Options.CallGraphOutput.empty() && Inputs.size() > 1;
+    std::vector<cfg::CallEdges> Calls(MergeCalls ? Inputs.size() : 0);
+
+    std::atomic<size_t> Failures{0};
+    for (const auto &Unit : Units) {
+        ToolOptions UnitOptions = Inputs.size() > 1 ? ForInput(Options, Unit.Path) : Options;
+        if (Merge)
+            UnitOptions.Summaries = &Summaries[Unit.Index];
+        if (MergeCalls)
+            UnitOptions.Calls = &Calls[Unit.Index];
+        Pool.Submit([&, UnitOptions] {
+            auto Start = std::chrono::steady_clock::now();
+            std::string Error;
+            bool Done;
+            if (IsSerializedAST(Unit.Path)) {
+                Done = UnitOptions.Metrics
+                           ? runConsumerOnAST<UnifiedConsumer>(Unit.Path, UnitOptions, Error, Unit.Directory)
+                           : runConsumerOnAST<ControlFlowConsumer>(Unit.Path, UnitOptions, Error, Unit.Directory);
+            } else {
+                std::unique_ptr<FrontendAction> Action;
+                if (UnitOptions.Metrics)
+                    Action = std::make_unique<UnifiedAction>(UnitOptions);
+                else
+                    Action = std::make_unique<ControlFlowAction>(UnitOptions);
+                Done = runToolOnFile(std::move(Action), Unit.Path, Error, Unit.Args, Unit.Directory);
+            }
+            if (!Done) {
+                std::cerr << "Ошибка: не удалось обработать файл " + Unit.Path + ": " + Error + "\n";
+                Failures++;
+                return;
+            }
+            std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+            Costs.Record(Unit.Path, Unit.Bytes, Unit.Includes, Elapsed.count());
+        }, Unit.Cost);
+    }
+    Pool.WaitAll();
+
+    // In input order, the order the units finished in would change which
+    // of the duplicates is kept
+    if (Merge) {
+        abreu::Project Project;
+        for (auto &Unit : Summaries)
+            Project.Add(std::move(Unit));
+        EmitMetrics(Project, Options);
+    }
+    if (MergeCalls) {
+        cfg::CallEdges Merged;
+        for (const auto &Unit : Calls)
+            Merged.Add(Unit);
+        EmitCallGraph(Merged.Build(), Options, std::cout);
+    }
+
+    if (!CostHistory.empty() && !Costs.Save(CostHistory))
+        std::cerr << "Ошибка: не удалось сохранить историю " << CostHistory << std::endl;
+
+    if (Writer) {
+        Writer->Close();
+        if (Writer->Failures())
+            return 1;
+    }
+
+    return Failures ? 1 : 0;
 }
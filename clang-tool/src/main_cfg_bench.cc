@@ -0,0 +1,238 @@
+#include <clang/Tooling/CommonOptionsParser.h>
+#include <llvm/Support/CommandLine.h>
+
+#include "clang/Tooling/CommonOptionsParser.h"
+#include "clang/Tooling/Tooling.h"
+
+#include "action.hpp"
+#include "control_flow/equivalence.hpp"
+#include "input.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+using namespace std;
+using namespace llvm;
+using namespace clang;
+using namespace clang::tooling;
+
+// Every allocation of the process goes through here, so the delta around a
+// build is what the backend (and clang::CFG itself) asked for. The aligned
+// forms matter: BumpPtrAllocator slabs, which hold clang::CFG, come from
+// allocate_buffer through them.
+static size_t AllocatedBytes = 0;
+
+static void* Allocate(size_t Size, size_t Alignment = 0) {
+    AllocatedBytes += Size;
+    void* Ptr = nullptr;
+    if (Alignment > alignof(std::max_align_t)) {
+        if (::posix_memalign(&Ptr, Alignment, Size ? Size : 1) != 0)
+            Ptr = nullptr;
+    } else {
+        Ptr = std::malloc(Size ? Size : 1);
+    }
+    return Ptr;
+}
+
+void* operator new(size_t Size) {
+    if (void* Ptr = Allocate(Size))
+        return Ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t Size, std::align_val_t Alignment) {
+    if (void* Ptr = Allocate(Size, size_t(Alignment)))
+        return Ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t Size, const std::nothrow_t&) noexcept { return Allocate(Size); }
+void* operator new(size_t Size, std::align_val_t Alignment, const std::nothrow_t&) noexcept {
+    return Allocate(Size, size_t(Alignment));
+}
+
+// Arrays reach the forms above by default, only the byte count matters
+void operator delete(void* Ptr) noexcept { std::free(Ptr); }
+void operator delete(void* Ptr, size_t) noexcept { std::free(Ptr); }
+void operator delete(void* Ptr, const std::nothrow_t&) noexcept { std::free(Ptr); }
+void operator delete(void* Ptr, std::align_val_t) noexcept { std::free(Ptr); }
+void operator delete(void* Ptr, size_t, std::align_val_t) noexcept { std::free(Ptr); }
+void operator delete(void* Ptr, std::align_val_t, const std::nothrow_t&) noexcept { std::free(Ptr); }
+
+static cl::OptionCategory BenchCategory("clang-cfg-bench options");
+
+static cl::list<std::string> InputFilenames(cl::Positional, cl::desc("<corpus files>"), cl::cat(BenchCategory));
+
+static cl::opt<std::string> ReportFilename("o", cl::desc("Per-function report (TSV)"),
+    cl::init("cfg_bench.tsv"), cl::cat(BenchCategory));
+
+static cl::opt<unsigned> Repeat("repeat", cl::desc("Builds per function and backend, best time is kept"),
+    cl::init(5), cl::cat(BenchCategory));
+
+static cl::opt<bool> CompareLabels("compare-labels", cl::desc("Treat differing node labels as divergence"),
+    cl::cat(BenchCategory));
+
+struct Measurement {
+    bool Supported = false;
+    double Micros = 0;
+    size_t Bytes = 0;
+    std::unique_ptr<cfg::Arena> Nodes;
+    cfg::ast::Node* Graph = nullptr;
+};
+
+struct Totals {
+    size_t Functions = 0;
+    size_t Compared = 0;
+    size_t Diverged = 0;
+    size_t BuilderUnsupported = 0;
+    size_t ClangUnsupported = 0;
+    double BuilderMicros = 0;
+    double ClangMicros = 0;
+    size_t BuilderBytes = 0;
+    size_t ClangBytes = 0;
+};
+
+static Totals Total;
+
+Measurement Measure(clang::FunctionDecl* FuncDecl, clang::ASTContext* Context, CfgBackend Backend) {
+    Measurement Result;
+
+    for (unsigned Run = 0; Run < std::max(1u, unsigned(Repeat)); ++Run) {
+        auto Nodes = std::make_unique<cfg::Arena>();
+        size_t BytesBefore = AllocatedBytes;
+        auto Start = std::chrono::steady_clock::now();
+
+        cfg::ast::Node* Graph = nullptr;
+        try {
+            Graph = cfg::CreateFunction(FuncDecl, Context, Backend, *Nodes);
+        } catch (std::exception&) {
+            return Result;
+        }
+
+        auto Micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - Start).count();
+        if (!Result.Supported || Micros < Result.Micros)
+            Result.Micros = Micros;
+
+        Result.Supported = true;
+        Result.Bytes = AllocatedBytes - BytesBefore;
+        Result.Nodes = std::move(Nodes);
+        Result.Graph = Graph;
+    }
+
+    return Result;
+}
+
+struct BenchVisitor : RecursiveASTVisitor<BenchVisitor>
+{
+private:
+    ASTContext *Context;
+    std::string File;
+    std::ofstream &Report;
+
+public:
+    BenchVisitor(ASTContext *Context, const std::string &File, std::ofstream &Report)
+        : Context(Context), File(File), Report(Report) {}
+
+    bool VisitFunctionDecl(FunctionDecl *FuncDecl) {
+        if (!FuncDecl->doesThisDeclarationHaveABody())
+            return true;
+        if (!Context->getSourceManager().isInMainFile(FuncDecl->getLocation()))
+            return true;
+
+        Measurement Builder = Measure(FuncDecl, Context, CfgBackend::Builder);
+        Measurement Clang = Measure(FuncDecl, Context, CfgBackend::Clang);
+
+        std::string Status;
+        if (!Builder.Supported || !Clang.Supported) {
+            Status = !Builder.Supported ? "builder-unsupported" : "clang-unsupported";
+        } else {
+            auto Diff = cfg::graphiz::compareGraphs(Builder.Graph->FlowStart(), Clang.Graph->FlowStart(), CompareLabels);
+            Status = Diff.Equal ? "equal" : "diverged at " + std::to_string(Diff.Node) + ": " + Diff.Reason;
+
+            Total.Compared++;
+            Total.Diverged += !Diff.Equal;
+            Total.BuilderMicros += Builder.Micros;
+            Total.ClangMicros += Clang.Micros;
+            Total.BuilderBytes += Builder.Bytes;
+            Total.ClangBytes += Clang.Bytes;
+        }
+
+        Total.Functions++;
+        Total.BuilderUnsupported += !Builder.Supported;
+        Total.ClangUnsupported += !Clang.Supported;
+
+        for (char &C : Status)
+            if (C == '\n' || C == '\t')
+                C = ' ';
+
+        Report << File << '\t' << FuncDecl->getNameAsString() << '\t'
+               << Builder.Micros << '\t' << Clang.Micros << '\t'
+               << Builder.Bytes << '\t' << Clang.Bytes << '\t' << Status << '\n';
+        return true;
+    }
+};
+
+struct BenchConsumer : clang::ASTConsumer
+{
+private:
+  BenchVisitor Visitor;
+
+public:
+  BenchConsumer(ASTContext *Context, const std::string &File, std::ofstream &Report)
+    : Visitor(Context, File, Report) {}
+
+  void HandleTranslationUnit(clang::ASTContext &Context) override {
+    Visitor.TraverseDecl(Context.getTranslationUnitDecl());
+  }
+};
+
+struct BenchAction : clang::ASTFrontendAction
+{
+private:
+  std::string File;
+  std::ofstream &Report;
+
+public:
+  BenchAction(const std::string &File, std::ofstream &Report) : File(File), Report(Report) {}
+
+  virtual std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(clang::CompilerInstance &Compiler,
+                                                                llvm::StringRef InFile)
+  {
+    return std::make_unique<BenchConsumer>(&Compiler.getASTContext(), File, Report);
+  }
+};
+
+int main(int argc, char **argv) {
+    cl::HideUnrelatedOptions(BenchCategory);
+    cl::ParseCommandLineOptions(argc, argv);
+
+    if (InputFilenames.empty()) {
+        std::cerr << "Ошибка: укажите файлы корпуса как аргументы командной строки." << std::endl;
+        return 1;
+    }
+
+    std::ofstream Report(ReportFilename);
+    Report << "file\tfunction\tbuilder_us\tclang_us\tbuilder_bytes\tclang_bytes\tstatus\n";
+
+    for (const auto &File : InputFilenames) {
+        std::string Error;
+        if (!runToolOnFile(std::make_unique<BenchAction>(File, Report), File, Error)) {
+            std::cerr << "Ошибка: не удалось обработать файл " << File << ": " << Error << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "Functions: " << Total.Functions
+              << " (builder unsupported: " << Total.BuilderUnsupported
+              << ", clang unsupported: " << Total.ClangUnsupported << ")" << std::endl;
+    std::cout << "Compared: " << Total.Compared << ", diverged: " << Total.Diverged << std::endl;
+    std::cout << "Builder: " << Total.BuilderMicros << " us, " << Total.BuilderBytes << " bytes" << std::endl;
+    std::cout << "Clang:   " << Total.ClangMicros << " us, " << Total.ClangBytes << " bytes" << std::endl;
+    if (Total.Compared)
+        std::cout << "Faster backend: " << (Total.BuilderMicros <= Total.ClangMicros ? "builder" : "clang") << std::endl;
+
+    return 0;
+}